@@ -0,0 +1,121 @@
+#pragma once
+#include <stdint.h>
+#include <string_view>
+#include "morse-tables.cpp"
+
+using namespace std;
+/**
+* C++ MorseBeacon Class file used by morse.cpp and morse-wav.cpp
+* Fixed beacon and ID texts, encoded at compile time with the same code
+* tables as Morse:
+*
+* symbols: table symbols, MorseTable::SPACE between words
+* morse:   dots, dashes and spaces, the same text as Morse::morse_encode
+* runs:    keying in elements, > 0 key down, < 0 key up (gaps merged),
+*          the same timing MorseWav renders from the morse text
+*
+* A MorseWav made from a beacon runs tone() straight from the runs, without
+* parsing and table lookups. The sample count is known before rendering.
+* A beacon-only program needs no Morse class: this file, morse-tables.cpp
+* and morse-wav.cpp with what that includes (morse-stats, morse-cache,
+* morse-channel and morse-index, so also atomic, mutex, unordered_map and
+* the other containers), whether it uses them or not.
+*
+* Example:
+*   constexpr MorseBeacon beacon("VVV DE PARIS <AR>", morse_table_itu);
+*   MorseWav mw(beacon, 700.0, 18.0, 8000.0, 1);
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+template<size_t N>
+class MorseBeacon
+{
+public:
+    enum
+    {
+        MAX_MORSE = N * (MorseTable::MAX_ELEMENTS + 2), // a symbol and its gap per text byte at most
+        MAX_RUNS = 2 * MAX_MORSE
+    };
+
+    int16_t symbols[N] = {};        // symbols and word spaces
+    int symbol_count = 0;
+    char morse[MAX_MORSE + 1] = {}; // morse text, '\0' ended
+    int morse_size = 0;
+    int8_t runs[MAX_RUNS] = {};     // keying in elements
+    int run_count = 0;
+    long elements = 0;              // length in elements
+
+public:
+    /**
+    * Encode a string literal, at compile time when the object is constexpr
+    *
+    * @param text - UTF-8, prosigns written <SK>
+    * @param table
+    */
+    constexpr MorseBeacon(const char(&text)[N], const MorseTable& table)
+    {
+        string_view str(text, N - 1);
+        bool first = true, space = false;
+        for (size_t i = 0; i < str.size();)
+        {
+            int sym = table.next(str, i);
+            if (sym < 0)
+            {
+                space = !first;
+                continue;
+            }
+            if (!first)
+            {
+                if (space) symbols[symbol_count++] = MorseTable::SPACE;
+                add_morse(space ? "  " : " ");
+            }
+            symbols[symbol_count++] = (int16_t)sym;
+            char code[MorseTable::MAX_ELEMENTS + 1] = {};
+            int len = 0;
+            while ((table.codes[sym] >> len) > 1) len++;
+            for (int k = 0; k < len; k++) code[k] = (table.codes[sym] >> (len - 1 - k)) & 1 ? '-' : '.';
+            add_morse(code);
+            first = false;
+            space = false;
+        }
+        // dit 1 on 1 off, dah 3 on 1 off, space 2 off, as MorseWav
+        for (int k = 0; k < morse_size; k++)
+        {
+            if (morse[k] == '.') { add_run(1); add_run(-1); }
+            if (morse[k] == '-') { add_run(3); add_run(-1); }
+            if (morse[k] == ' ') add_run(-2);
+        }
+    }
+
+public:
+    /**
+    * Get the morse text
+    *
+    * @return string_view
+    */
+    constexpr string_view code() const { return string_view(morse, morse_size); }
+
+    /**
+    * Get the number of PCM samples (frames) MorseWav renders, same quantum as MorseWav
+    *
+    * @param wpm
+    * @param sps
+    * @return long
+    */
+    constexpr long samples(double wpm, double sps) const { return elements * (long)(1.2 / wpm * sps); }
+
+private:
+    constexpr void add_morse(const char* str)
+    {
+        for (; *str != '\0'; str++) morse[morse_size++] = *str;
+    }
+
+    constexpr void add_run(int n)
+    {
+        elements += n > 0 ? n : -n;
+        if (n < 0 && run_count > 0 && runs[run_count - 1] < 0) runs[run_count - 1] = (int8_t)(runs[run_count - 1] + n);
+        else runs[run_count++] = (int8_t)n;
+    }
+};
@@ -0,0 +1,481 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include "morse-tables.cpp"
+
+using namespace std;
+/**
+* C++ MorseBeam Class file used by morse.cpp
+* Beam search decoder for noisy keying: soft mark and space durations
+* (in elements) or soft dit/dah and gap probabilities in, text out.
+*
+* A hypothesis is a path through the code tree of the morse table: the
+* code of the letter being keyed, the last symbol and the position in the
+* dictionary. A mark extends the code with a dit or a dah (only towards
+* codes the table has), a space continues the letter or ends it with a
+* letter or word gap. Scores are log probabilities: gaussian durations
+* around 1 and 3 elements (marks) and 1, 3 and word_gap elements (spaces),
+* plus the optional priors. Hypotheses in the same state are merged
+* (Viterbi), the best beam are kept.
+*
+* Priors, both optional: a character bigram model trained from text, and a
+* dictionary (callsigns, words): every character of a word outside it costs
+* oov nats.
+*
+* Memory is bounded: before every observation the oldest symbols of the
+* best are committed while it holds more than BEAM_LAG / 2, hypotheses that
+* disagree with a committed symbol are dropped, so a decoder holds
+* beam * BEAM_LAG symbols whatever the length of the input. The others
+* have room for BEAM_LAG / 2 symbols more than the best.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseBeam
+{
+public:
+    /**
+    * Decoder settings
+    */
+    struct Params
+    {
+        int beam = 16;          // hypotheses kept, -beam:<n>
+        double jitter = 0.3;    // keying jitter per element, std dev in elements
+        double resolution = 0.15; // timing error of the front end, std dev in elements
+        double word_gap = 5.0;  // elements between words: 5 here (1 + 2 + 2), 7 in ITU timing
+        double lm_weight = 1.0; // weight of the bigram model
+        double oov = 2.0;       // cost of a character of a word not in the dictionary
+    };
+
+    /**
+    * Instance variables
+    */
+private:
+#define BEAM_LAG 32     // symbols a hypothesis holds, the best commits at half of them
+#define BEAM_MAX 1024   // largest beam
+    struct Hyp
+    {
+        float score;
+        uint16_t code;              // letter being keyed, leading 1 marker
+        int16_t last;               // last symbol, SPACE at the start of a word
+        int32_t word;               // dictionary node, -1 outside the dictionary
+        int pending;                // symbols not committed yet
+        int16_t symbols[BEAM_LAG];  // not committed yet
+    };
+    const MorseTable& Table;
+    Params P;
+    vector<uint8_t> Prefix;         // code -> some symbol starts with it
+    vector<float> Lm;               // bigram log probabilities, see lm_index
+    vector<uint8_t> Terminal;       // dictionary node ends a word
+    unordered_map<uint64_t, int32_t> Child; // dictionary node and symbol -> node
+    vector<Hyp> Beam, Next;
+    vector<int> Order;
+    vector<uint64_t> Seen;          // keys merged this step, open addressing
+    vector<uint32_t> Stamp;
+    uint32_t Step = 0;
+    string Out;                     // committed text
+    long long Expanded = 0;         // hypotheses scored
+
+public:
+    /**
+    * Constructor
+    *
+    * @param table
+    * @param params
+    */
+    MorseBeam(const MorseTable& table, const Params& params) : Table(table), P(params), Prefix(MorseTable::CODES, 0)
+    {
+        if (P.beam < 1) P.beam = 1;
+        if (P.beam > BEAM_MAX) P.beam = BEAM_MAX;
+        for (int s = 0; s < table.count; s++)
+        {
+            for (uint32_t c = table.codes[s]; c >= 1; c >>= 1) Prefix[c] = 1;
+        }
+        Terminal.push_back(0); // root
+        Beam.reserve(P.beam);
+        Next.reserve(3 * (size_t)P.beam);
+        Order.reserve(3 * (size_t)P.beam);
+        Seen.assign(8 * (size_t)P.beam, 0);
+        Stamp.assign(Seen.size(), 0);
+        reset();
+    }
+
+public:
+    /**
+    * Train the bigram prior from text (UTF-8, any length)
+    *
+    * @param text
+    */
+    void train(string_view text)
+    {
+        const int n = MorseTable::MAX_SYMBOLS + 1;
+        vector<double> count((size_t)n * n, 0.5); // add-half smoothing
+        int last = MorseTable::SPACE;
+        for (size_t i = 0; i < text.size();)
+        {
+            int sym = Table.next(text, i);
+            if (sym < 0) sym = MorseTable::SPACE;
+            if (sym == MorseTable::SPACE && last == MorseTable::SPACE) continue;
+            count[(size_t)lm_index(last) * n + lm_index(sym)] += 1.0;
+            last = sym;
+        }
+        // log P(b | a) / P(b): only what the last symbol tells, no cost per symbol,
+        // so the prior does not favour fewer letters or fewer word gaps
+        vector<double> unigram(n, 0.0);
+        double total = 0.0;
+        for (int a = 0; a <= Table.count; a++)
+        {
+            for (int b = 0; b <= Table.count; b++) unigram[b] += count[(size_t)a * n + b];
+        }
+        for (int b = 0; b <= Table.count; b++) total += unigram[b];
+        Lm.assign((size_t)n * n, 0.0f);
+        for (int a = 0; a <= Table.count; a++)
+        {
+            double sum = 0.0;
+            for (int b = 0; b <= Table.count; b++) sum += count[(size_t)a * n + b];
+            for (int b = 0; b <= Table.count; b++) Lm[(size_t)a * n + b] = (float)log(count[(size_t)a * n + b] / sum * total / unigram[b]);
+        }
+    }
+
+    /**
+    * Add words to the dictionary prior, separated by white space
+    *
+    * @param words
+    */
+    void dictionary(string_view words)
+    {
+        int32_t node = 0;
+        for (size_t i = 0; i < words.size();)
+        {
+            int sym = Table.next(words, i);
+            if (sym < 0)
+            {
+                if (node > 0) Terminal[node] = 1;
+                node = 0;
+                continue;
+            }
+            uint64_t key = (uint64_t)node * MorseTable::MAX_SYMBOLS + sym;
+            auto it = Child.find(key);
+            if (it == Child.end())
+            {
+                it = Child.emplace(key, (int32_t)Terminal.size()).first;
+                Terminal.push_back(0);
+            }
+            node = it->second;
+        }
+        if (node > 0) Terminal[node] = 1;
+    }
+
+public:
+    /**
+    * Start a new message
+    */
+    void reset()
+    {
+        Beam.clear();
+        Hyp h;
+        h.score = 0.0f;
+        h.code = 1;
+        h.last = MorseTable::SPACE;
+        h.word = 0;
+        h.pending = 0;
+        Beam.push_back(h);
+        Out.clear();
+    }
+
+    /**
+    * Observe a mark of a duration in elements
+    *
+    * @param elements
+    */
+    void mark(double elements)
+    {
+        mark_ll(duration_ll(elements, 1.0), duration_ll(elements, 3.0));
+    }
+
+    /**
+    * Observe a space of a duration in elements
+    *
+    * @param elements
+    */
+    void space(double elements)
+    {
+        space_ll(duration_ll(elements, 1.0), duration_ll(elements, 3.0), duration_ll(elements, P.word_gap));
+    }
+
+    /**
+    * Observe a mark as log likelihoods of a dit and a dah
+    *
+    * @param dit
+    * @param dah
+    */
+    void mark_ll(double dit, double dah)
+    {
+        commit();
+        Next.clear();
+        for (const Hyp& h : Beam)
+        {
+            for (int bit = 0; bit < 2; bit++)
+            {
+                uint32_t code = ((uint32_t)h.code << 1) | bit;
+                if (code >= MorseTable::CODES || !Prefix[code]) continue;
+                Hyp n = h;
+                n.code = (uint16_t)code;
+                n.score = h.score + (float)(bit ? dah : dit);
+                Next.push_back(n);
+            }
+        }
+        prune();
+    }
+
+    /**
+    * Observe a space as log likelihoods of an element, letter and word gap
+    *
+    * @param element
+    * @param letter
+    * @param word
+    */
+    void space_ll(double element, double letter, double word)
+    {
+        commit();
+        Next.clear();
+        for (const Hyp& h : Beam)
+        {
+            if (h.code == 1) continue; // spaces come after marks
+            Hyp n = h;
+            n.score = h.score + (float)element;
+            Next.push_back(n);
+            int sym = Table.symbol(h.code);
+            if (sym < 0) continue;
+            n = h;
+            n.score = h.score + (float)letter;
+            if (end_letter(n, sym)) Next.push_back(n);
+            n = h;
+            n.score = h.score + (float)word;
+            if (end_letter(n, sym) && end_word(n)) Next.push_back(n);
+        }
+        prune();
+    }
+
+    /**
+    * End of the message: end the last letter and get the decoded text
+    *
+    * @return string
+    */
+    string finish()
+    {
+        Next.clear();
+        for (const Hyp& h : Beam)
+        {
+            Hyp n = h;
+            if (h.code != 1)
+            {
+                int sym = Table.symbol(h.code);
+                if (sym < 0 || !end_letter(n, sym)) continue;
+            }
+            if (n.last != MorseTable::SPACE)
+            {
+                if (n.word > 0 && !Terminal[n.word]) n.score -= (float)P.oov;
+                if (!Lm.empty()) n.score += (float)(P.lm_weight * bigram(n.last, MorseTable::SPACE));
+            }
+            Next.push_back(n);
+        }
+        string text = Out;
+        if (!Next.empty())
+        {
+            const Hyp* best = &Next[0];
+            for (const Hyp& h : Next) if (h.score > best->score) best = &h;
+            for (int k = 0; k < best->pending; k++) text += best->symbols[k] == MorseTable::SPACE ? " " : Table.text[best->symbols[k]];
+        }
+        while (!text.empty() && text.back() == ' ') text.pop_back();
+        reset();
+        return text;
+    }
+
+    /**
+    * Get the number of hypotheses scored so far (cost)
+    *
+    * @return long long
+    */
+    long long expanded() const { return Expanded; }
+
+private:
+    /**
+    * Log likelihood of a duration: gaussian around the mean, the jitter of
+    * every element adds up (variance grows with the mean)
+    */
+    double duration_ll(double elements, double mean) const
+    {
+        double var = P.resolution * P.resolution + P.jitter * P.jitter * mean;
+        double x = elements - mean;
+        return -0.5 * (x * x / var + log(var));
+    }
+
+    static int lm_index(int sym) { return sym == MorseTable::SPACE ? 0 : sym + 1; }
+
+    double bigram(int last, int sym) const
+    {
+        return Lm[(size_t)lm_index(last) * (MorseTable::MAX_SYMBOLS + 1) + lm_index(sym)];
+    }
+
+    /**
+    * Append a letter to a hypothesis, with the priors
+    *
+    * @param h
+    * @param sym
+    * @return bool
+    */
+    bool end_letter(Hyp& h, int sym)
+    {
+        if (!Lm.empty()) h.score += (float)(P.lm_weight * bigram(h.last, sym));
+        if (Terminal.size() > 1)
+        {
+            if (h.word >= 0)
+            {
+                auto it = Child.find((uint64_t)h.word * MorseTable::MAX_SYMBOLS + sym);
+                h.word = it == Child.end() ? -1 : it->second;
+            }
+            if (h.word < 0) h.score -= (float)P.oov;
+        }
+        h.code = 1;
+        h.last = (int16_t)sym;
+        return push(h, sym);
+    }
+
+    bool end_word(Hyp& h)
+    {
+        if (Terminal.size() > 1 && h.word > 0 && !Terminal[h.word]) h.score -= (float)P.oov;
+        if (!Lm.empty()) h.score += (float)(P.lm_weight * bigram(h.last, MorseTable::SPACE));
+        h.word = 0;
+        h.last = MorseTable::SPACE;
+        return push(h, MorseTable::SPACE);
+    }
+
+    bool push(Hyp& h, int sym)
+    {
+        if (h.pending == BEAM_LAG) return false; // BEAM_LAG / 2 symbols more than the best, dropped
+        h.symbols[h.pending++] = (int16_t)sym;
+        return true;
+    }
+
+    /**
+    * Fixed lag, before the beam is extended (so a letter and its word gap
+    * always fit): commit the oldest symbols of the best while it holds more
+    * than BEAM_LAG / 2, drop who disagrees
+    */
+    void commit()
+    {
+        while (!Beam.empty() && Beam[0].pending > BEAM_LAG / 2)
+        {
+            int16_t sym = Beam[0].symbols[0];
+            Out += sym == MorseTable::SPACE ? " " : Table.text[sym];
+            size_t kept = 0;
+            for (Hyp& h : Beam)
+            {
+                if (h.pending == 0 || h.symbols[0] != sym) continue;
+                memmove(h.symbols, h.symbols + 1, (h.pending - 1) * sizeof(int16_t));
+                h.pending--;
+                Beam[kept++] = h;
+            }
+            Beam.resize(kept);
+        }
+    }
+
+    /**
+    * Keep the best beam of Next, one per state, best first
+    */
+    void prune()
+    {
+        if (Next.empty()) return; // nothing fits: skip the observation, keep the beam
+        Expanded += Next.size();
+        Order.resize(Next.size());
+        for (size_t i = 0; i < Next.size(); i++) Order[i] = (int)i;
+        sort(Order.begin(), Order.end(), [this](int a, int b) { return Next[a].score > Next[b].score; });
+        Step++;
+        Beam.clear();
+        for (int i : Order)
+        {
+            const Hyp& h = Next[i];
+            uint64_t key = ((uint64_t)(uint32_t)h.word << 32) | ((uint64_t)(uint16_t)h.last << 16) | h.code;
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 40) % Seen.size();
+            bool merged = false;
+            for (; Stamp[slot] == Step; slot = (slot + 1) % Seen.size())
+            {
+                if (Seen[slot] == key) { merged = true; break; }
+            }
+            if (merged) continue; // a better path is in the same state
+            Seen[slot] = key;
+            Stamp[slot] = Step;
+            Beam.push_back(h);
+            if ((int)Beam.size() == P.beam) break;
+        }
+        float best = Beam.empty() ? 0.0f : Beam[0].score;
+        for (Hyp& h : Beam) h.score -= best; // scores relative to the best, in range on long inputs
+    }
+
+public:
+    /**
+    * Get keying durations from PCM: Goertzel amplitude at the tone over
+    * blocks of a quarter element every eighth element, threshold half way
+    * between the quiet and the loud blocks (a block half keyed is half
+    * way), glitches up to a quarter element removed.
+    *
+    * @param pcm - interleaved, first channel used
+    * @param frames
+    * @param channels
+    * @param sps
+    * @param hz - tone
+    * @param wpm - for the element length
+    * @return vector<float> - elements, > 0 mark, < 0 space, starting with a mark
+    */
+    static vector<float> durations(const int16_t* pcm, long frames, int channels, double sps, double hz, double wpm)
+    {
+        long n = (long)(1.2 / wpm * sps);
+        long block = n / 4 > 0 ? n / 4 : 1, hop = block / 2 > 0 ? block / 2 : 1;
+        long blocks = frames >= block ? (frames - block) / hop + 1 : 0;
+        vector<float> level(blocks);
+        double coeff = 2.0 * cos(2.0 * 3.141592653589793 * hz / sps);
+        for (long b = 0; b < blocks; b++)
+        {
+            double s1 = 0.0, s2 = 0.0;
+            const int16_t* p = pcm + (size_t)b * hop * channels;
+            for (long i = 0; i < block; i++)
+            {
+                double s = p[i * channels] + coeff * s1 - s2;
+                s2 = s1;
+                s1 = s;
+            }
+            level[b] = (float)sqrt(fabs(s1 * s1 + s2 * s2 - coeff * s1 * s2));
+        }
+        vector<float> runs;
+        if (blocks == 0) return runs;
+        vector<float> sorted(level);
+        sort(sorted.begin(), sorted.end());
+        float threshold = 0.5f * (sorted[blocks / 10] + sorted[blocks - 1 - blocks / 10]);
+        vector<uint8_t> on(blocks);
+        for (long b = 0; b < blocks; b++)
+        {
+            int votes = 0; // median of 5 blocks, glitches up to a quarter element removed
+            for (long k = b - 2; k <= b + 2; k++) votes += k >= 0 && k < blocks && level[k] > threshold;
+            on[b] = votes >= 3;
+        }
+        double unit = (double)hop / n;
+        long start = 0;
+        while (start < blocks && !on[start]) start++;
+        for (long b = start; b < blocks;)
+        {
+            long e = b;
+            while (e < blocks && on[e] == on[b]) e++;
+            if (e < blocks || on[b]) runs.push_back((float)((on[b] ? 1 : -1) * (e - b) * unit));
+            b = e;
+        }
+        return runs;
+    }
+};
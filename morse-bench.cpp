@@ -0,0 +1,732 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+/**
+* C++ MorseBench Class file used by morse.cpp
+* Round-trip regression and throughput harness:
+* random text -> morse_encode -> MorseWav (in memory) -> audio decode -> morse_decode
+*
+* Every cell of the -hz / -wpm / -sps grid must give back exactly the text that went in,
+* also for the sub-optimal ratios check_ratios() warns about.
+* With -stress the same work runs on many threads against one shared Morse
+* and word cache and must give the single thread results. It compares
+* outputs only: a mismatch shows a race, a clean run does not prove there
+* is none.
+* The beam search decoder is compared with hard decisions on noisy keying.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseBench
+{
+    /**
+    * Instance variables
+    */
+private:
+    const Morse& M;             // morse tables and codec
+    vector<string> Charset; // characters of the code table that decode to themselves (UTF-8)
+    long Chars;           // characters of random text per grid cell
+    mt19937 Rng;          // deterministic text generator
+    int Cells = 0;        // grid cells tested
+    int Failures = 0;     // grid cells without exact round trip
+    MorseWavCache Cache;  // word cache, must render the same samples as without
+    // stage totals: seconds and units (chars or samples) processed
+    double t_encode = 0, t_synth = 0, t_cached = 0, t_nco = 0, t_stream = 0, t_channel = 0, t_audio = 0, t_decode = 0;
+    double n_encode = 0, n_synth = 0, n_cached = 0, n_nco = 0, n_stream = 0, n_channel = 0, n_audio = 0, n_decode = 0;
+    double nco_rms = 0;   // worst rms difference of the fixed-point synthesis (LSB)
+    int nco_max = 0;      // largest difference of the fixed-point synthesis (LSB)
+
+    /**
+    * One feature check of a cell: name, result and what it means when it fails
+    */
+    struct Check
+    {
+        const char* name;
+        bool ok;
+        string message;
+    };
+
+public:
+    /**
+    * Constructor
+    *
+    * @param morse
+    * @param chars
+    * @param seed
+    */
+    MorseBench(const Morse& morse, long chars, unsigned long seed) : M(morse), Chars(chars), Rng(seed)
+    {
+        for (const string& c : M.morse_charset())
+        {
+            if (M.morse_decode(M.morse_encode(c)) == c) Charset.push_back(c);
+        }
+    }
+
+public:
+    /**
+    * Run the full grid and print a report
+    *
+    * @return int - number of failed cells
+    */
+    int run()
+    {
+        const double hz[] = { 37.0, 440.0, 739.99, 1050.0, 3000.0 };
+        const double wpm[] = { 5.0, 13.0, 16.0, 18.0, 50.0 };
+        const double sps[] = { 8000.0, 11025.0, 22050.0, 44100.0 };
+        printf("%9s %6s %8s %3s %5s %s\n", "hz", "wpm", "sps", "ch", "poor", "result");
+        for (double s : sps)
+            for (double w : wpm)
+                for (double h : hz)
+                    for (int ch = 1; ch <= 2; ch++)
+                        run_cell(random_text(), h, w, s, ch);
+        beacons();
+        prosigns();
+        indexes();
+        records();
+        beam_report();
+        printf("\n");
+        print_stage("morse_encode", t_encode, n_encode, "chars");
+        print_stage("MorseWav", t_synth, n_synth, "samples");
+        print_stage("word cache", t_cached, n_cached, "samples");
+        print_stage("MorseWav nco", t_nco, n_nco, "samples");
+        print_stage("MorseStream", t_stream, n_stream, "samples");
+        print_stage("channel", t_channel, n_channel, "samples");
+        print_stage("audio decode", t_audio, n_audio, "samples");
+        print_stage("morse_decode", t_decode, n_decode, "chars");
+        printf("nco vs sin(): worst rms %.3lf LSB, max %d LSB\n", nco_rms, nco_max);
+        printf("word cache: %llu hits, %llu misses, %zu words\n", (unsigned long long)Cache.hits(), (unsigned long long)Cache.misses(), Cache.words());
+        printf("\n%d of %d cells round-trip exact, %d failed\n", Cells - Failures, Cells, Failures);
+        return Failures;
+    }
+
+public:
+    /**
+    * Encode, decode and render the same jobs on many threads at once,
+    * sharing the Morse object and the word cache, and compare every
+    * result with the one computed on a single thread first. Races that do
+    * not change a result go unnoticed.
+    *
+    * @param threads
+    * @param rounds - passes over the jobs per thread
+    * @return int - number of mismatches
+    */
+    int stress(int threads, int rounds)
+    {
+        struct Job
+        {
+            string text;
+            double hz, wpm, sps;
+            int channels;
+            bool nco;
+            string morse, binary, hexa, decoded;
+            uint64_t pcm;   // hash of the rendered samples
+        };
+        const double hz[] = { 440.0, 739.99, 1050.0 };
+        const double wpm[] = { 13.0, 18.0, 25.0 };
+        vector<Job> jobs;
+        for (int i = 0; i < 48; i++)
+        {
+            Job j;
+            j.text = random_text();
+            j.hz = hz[i % 3];
+            j.wpm = wpm[(i / 3) % 3];
+            j.sps = i % 2 ? 8000.0 : 11025.0;
+            j.channels = 1 + (i / 9) % 2;
+            j.nco = (i / 18) % 2 == 1;
+            run_job(j.text, j.hz, j.wpm, j.sps, j.channels, j.nco, j.morse, j.binary, j.hexa, j.decoded, j.pcm);
+            jobs.push_back(j);
+        }
+        atomic<int> mismatches(0);
+        atomic<long> done(0);
+        auto t0 = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (int t = 0; t < threads; t++)
+        {
+            pool.emplace_back([&, t]
+            {
+                string morse, binary, hexa, decoded;
+                uint64_t pcm;
+                for (int r = 0; r < rounds; r++)
+                {
+                    for (size_t k = 0; k < jobs.size(); k++)
+                    {
+                        const Job& j = jobs[(k + t * 7) % jobs.size()];
+                        run_job(j.text, j.hz, j.wpm, j.sps, j.channels, j.nco, morse, binary, hexa, decoded, pcm);
+                        if (morse != j.morse || binary != j.binary || hexa != j.hexa || decoded != j.decoded || pcm != j.pcm)
+                            mismatches++;
+                        done++;
+                    }
+                }
+            });
+        }
+        for (auto& th : pool) th.join();
+        double s = seconds(t0, chrono::steady_clock::now());
+        printf("stress: %d threads, %ld jobs in %.3lf s (%.0lf jobs/s), %d mismatches\n", threads, done.load(), s, done / s, mismatches.load());
+        printf("word cache: %llu hits, %llu misses, %zu words\n", (unsigned long long)Cache.hits(), (unsigned long long)Cache.misses(), Cache.words());
+        return mismatches;
+    }
+
+private:
+    /**
+    * One stress job: the text codecs and a cached render
+    */
+    void run_job(const string& text, double hz, double wpm, double sps, int channels, bool nco,
+        string& morse, string& binary, string& hexa, string& decoded, uint64_t& pcm)
+    {
+        morse = M.morse_encode(text);
+        binary = M.morse_binary(text);
+        hexa = M.bin_morse_hexadecimal(text, 0);
+        decoded = M.hexadecimal_bin_txt(hexa, 0);
+        MorseWav mw(morse.c_str(), hz, wpm, sps, channels, &Cache, nco);
+        const int16_t* p = mw.get_pcm_data();
+        pcm = 14695981039346656037ull;
+        for (long i = 0; i < mw.get_pcm_count() * channels; i++) pcm = (pcm ^ (uint16_t)p[i]) * 1099511628211ull;
+    }
+
+private:
+    /**
+    * Test one grid cell: text -> morse -> pcm -> morse -> text
+    *
+    * @param text
+    * @param hz
+    * @param wpm
+    * @param sps
+    * @param channels
+    */
+    void run_cell(const string& text, double hz, double wpm, double sps, int channels)
+    {
+        string expect = M.trim(upper(text));
+        auto t0 = chrono::steady_clock::now();
+        string morse = M.morse_encode(text);
+        auto t1 = chrono::steady_clock::now();
+        MorseWav mw(morse.c_str(), hz, wpm, sps, channels);
+        auto t2 = chrono::steady_clock::now();
+        string heard = audio_decode(mw.get_pcm_data(), mw.get_pcm_count(), channels, mw.get_samples_per_element());
+        auto t3 = chrono::steady_clock::now();
+        string from_audio = M.morse_decode(heard);
+        string from_text = M.morse_decode(morse);
+        auto t4 = chrono::steady_clock::now();
+        t_encode += seconds(t0, t1); n_encode += (double)text.size();
+        t_synth += seconds(t1, t2); n_synth += (double)mw.get_pcm_count();
+        t_audio += seconds(t2, t3); n_audio += (double)mw.get_pcm_count();
+        t_decode += seconds(t3, t4); n_decode += 2.0 * morse.size();
+        string fast = "";
+        M.morse_encode_view(text, fast, 0);
+        // the round trip, then one named check per feature
+        const Check checks[] = {
+            { "text", from_text == expect, "morse_decode(morse_encode(text)) is not the text" },
+            { "audio", heard == morse, "audio decode heard other morse than rendered" },
+            { "round trip", from_audio == expect, "text decoded from the audio is not the text" },
+            { "encode_view", fast == morse, "morse_encode_view differs from morse_encode" },
+            check_cache(morse, mw, hz, wpm, sps, channels),
+            check_nco(morse, mw, hz, wpm, sps, channels),
+            check_channel(morse, hz, wpm, sps, channels),
+            check_stream(morse, mw, hz, wpm, sps, channels),
+        };
+        char row[64];
+        snprintf(row, sizeof row, "%9.2lf %6.1lf %8.0lf %3d %5d", hz, wpm, sps, channels, mw.ratio_warnings());
+        if (!report(checks, sizeof checks / sizeof checks[0], row, ""))
+        {
+            printf("  in:    %s\n  morse: %s\n  fast:  %s\n  heard: %s\n  audio: %s\n  text:  %s\n",
+                expect.c_str(), morse.c_str(), fast.c_str(), heard.c_str(), from_audio.c_str(), from_text.c_str());
+        }
+    }
+
+    /**
+    * Count and print a cell: ok, or FAIL with the names of the failed
+    * checks and a line per failed check
+    *
+    * @param checks
+    * @param count
+    * @param row - settings columns
+    * @param note - after the result
+    * @return bool - all checks ok
+    */
+    bool report(const Check* checks, size_t count, const char* row, const char* note)
+    {
+        string failed = "";
+        for (size_t i = 0; i < count; i++) if (!checks[i].ok) failed += string(failed.empty() ? " " : ", ") + checks[i].name;
+        Cells++;
+        if (!failed.empty()) Failures++;
+        printf("%s %s%s%s\n", row, failed.empty() ? "ok" : "FAIL:", failed.c_str(), note);
+        for (size_t i = 0; i < count; i++) if (!checks[i].ok) printf("  %s: %s\n", checks[i].name, checks[i].message.c_str());
+        return failed.empty();
+    }
+
+private:
+    /**
+    * Word cache (MorseWavCache): a render that fills the cache and one
+    * that copies from it must give the samples of MorseWav without it
+    */
+    Check check_cache(const string& morse, const MorseWav& mw, double hz, double wpm, double sps, int channels)
+    {
+        MorseWav warm(morse.c_str(), hz, wpm, sps, channels, &Cache);
+        auto t0 = chrono::steady_clock::now();
+        MorseWav cached(morse.c_str(), hz, wpm, sps, channels, &Cache);
+        t_cached += seconds(t0, chrono::steady_clock::now()); n_cached += (double)cached.get_pcm_count();
+        return { "cache", same_pcm(warm, mw, channels) && same_pcm(cached, mw, channels), "word cache rendered other samples" };
+    }
+
+    /**
+    * Fixed-point synthesis (-nco): within 1 LSB rms of sin()
+    */
+    Check check_nco(const string& morse, const MorseWav& mw, double hz, double wpm, double sps, int channels)
+    {
+        auto t0 = chrono::steady_clock::now();
+        MorseWav nco(morse.c_str(), hz, wpm, sps, channels, NULL, true);
+        t_nco += seconds(t0, chrono::steady_clock::now()); n_nco += (double)nco.get_pcm_count();
+        double rms = nco_difference(nco, mw, channels);
+        char message[64];
+        snprintf(message, sizeof message, "nco differs by %.3lf LSB rms", rms);
+        return { "nco", rms <= 1.0, message };
+    }
+
+    /**
+    * Radio channel (MorseChannel): the same seed must render the same samples
+    */
+    Check check_channel(const string& morse, double hz, double wpm, double sps, int channels)
+    {
+        MorseChannel::Params noisy;
+        noisy.snr = 10.0; noisy.qsb = 0.5; noisy.drift = 1.0; noisy.jitter = 0.05;
+        MorseChannel ch1(noisy, Cells), ch2(noisy, Cells);
+        auto t0 = chrono::steady_clock::now();
+        MorseWav air(morse.c_str(), hz, wpm, sps, channels, NULL, false, &ch1);
+        t_channel += seconds(t0, chrono::steady_clock::now()); n_channel += (double)air.get_pcm_count();
+        MorseWav again(morse.c_str(), hz, wpm, sps, channels, NULL, false, &ch2);
+        return { "channel", same_pcm(air, again, channels), "channel is not deterministic" };
+    }
+
+    /**
+    * MorseStream: pulled in odd blocks, float and nco, must be the samples of MorseWav
+    */
+    Check check_stream(const string& morse, const MorseWav& mw, double hz, double wpm, double sps, int channels)
+    {
+        MorseWav nco(morse.c_str(), hz, wpm, sps, channels, NULL, true);
+        auto t0 = chrono::steady_clock::now();
+        bool same = stream_same(morse, mw, hz, wpm, sps, channels, false);
+        t_stream += seconds(t0, chrono::steady_clock::now()); n_stream += (double)mw.get_pcm_count();
+        same = stream_same(morse, nco, hz, wpm, sps, channels, true) && same;
+        return { "stream", same, "stream filled other samples" };
+    }
+
+    static bool same_pcm(const MorseWav& a, const MorseWav& b, int channels)
+    {
+        return a.get_pcm_count() == b.get_pcm_count() &&
+            memcmp(a.get_pcm_data(), b.get_pcm_data(), a.get_pcm_count() * channels * sizeof(int16_t)) == 0;
+    }
+
+private:
+    /**
+    * Beacons encoded at compile time must give the morse of morse_encode
+    * (itu table), the samples of MorseWav from that morse and the sample
+    * count they promise
+    */
+    void beacons()
+    {
+        static constexpr MorseBeacon b1("VVV VVV DE MORSE <AR>", morse_table_itu);
+        static constexpr MorseBeacon b2("cq cq de paris, qth 52n? <SK>", morse_table_itu);
+        static constexpr MorseBeacon b3("  0123456789 / = <SOS>  ", morse_table_itu);
+        beacon_cell(b1, "VVV VVV DE MORSE <AR>", 739.99, 18.0, 8000.0, 1, false);
+        beacon_cell(b2, "cq cq de paris, qth 52n? <SK>", 1050.0, 25.0, 44100.0, 2, false);
+        beacon_cell(b3, "  0123456789 / = <SOS>  ", 440.0, 13.0, 22050.0, 1, true);
+    }
+
+    template<size_t N>
+    void beacon_cell(const MorseBeacon<N>& beacon, const char* text, double hz, double wpm, double sps, int channels, bool nco)
+    {
+        Morse itu;
+        string morse = itu.morse_encode(text);
+        MorseWav mw(morse.c_str(), hz, wpm, sps, channels, NULL, nco);
+        MorseWav fixed(beacon, hz, wpm, sps, channels, nco);
+        const Check checks[] = {
+            { "beacon code", beacon.code() == morse, "compile-time code is not the morse of morse_encode" },
+            { "beacon samples", fixed.get_pcm_count() == beacon.samples(wpm, sps), "rendered another sample count than promised" },
+            { "beacon pcm", same_pcm(fixed, mw, channels), "rendered other samples than MorseWav" },
+        };
+        char row[64];
+        snprintf(row, sizeof row, "%9.2lf %6.1lf %8.0lf %3d %5s", hz, wpm, sps, channels, "");
+        if (!report(checks, sizeof checks / sizeof checks[0], row, " (constexpr beacon)"))
+        {
+            printf("  in:     %s\n  morse:  %s\n  beacon: %.*s\n", text, morse.c_str(), (int)beacon.code().size(), beacon.code().data());
+        }
+    }
+
+private:
+    /**
+    * Every prosign, in every table, must encode to its code and decode
+    * back to its name, the aliases to the symbol of their code (see morse-tables.cpp)
+    */
+    void prosigns()
+    {
+        const char* aliases[][2] = { { "<HH>", "ERR" }, { "<BT>", "=" }, { "<KN>", "(" } };
+        for (const char* table : { "itu", "cyrillic" })
+        {
+            Morse m;
+            m.set_table(table);
+            string failed = "";
+            for (const MorseSymbol& s : morse_prosigns)
+            {
+                string expect = s.name;
+                for (auto& alias : aliases) if (expect == alias[0]) expect = alias[1];
+                string morse = m.morse_encode(s.name);
+                if (morse != s.code || m.morse_decode(morse) != expect) failed += string(" ") + s.name;
+            }
+            const Check check = { "prosigns", failed.empty(), "no round trip:" + failed };
+            char row[64], note[32];
+            snprintf(row, sizeof row, "%9s %6s %8s %3s %5s", "", "", "", "", "");
+            snprintf(note, sizeof note, " (prosigns, %s table)", table);
+            report(&check, 1, row, note);
+        }
+    }
+
+private:
+    /**
+    * A timing index must load back from its bytes, and must not load with
+    * settings MorseWav cannot render (zero wpm, no channels)
+    */
+    void indexes()
+    {
+        MorseIndex idx, back;
+        MorseWav mw(M.morse_encode("cq cq de k1abc").c_str(), 700.0, 20.0, 8000.0, 1, NULL, false, NULL, &idx);
+        string data = idx.bytes();
+        bool loads = back.load(data) && back.bytes() == data;
+        string zero_wpm = data, no_channels = data;
+        double wpm = 0.0;
+        uint32_t channels = 0;
+        memcpy(&zero_wpm[24], &wpm, sizeof wpm); // "MIDX", version, flags, channels, tone, wpm
+        memcpy(&no_channels[12], &channels, sizeof channels);
+        const Check checks[] = {
+            { "index load", loads, "an index did not load back from its bytes" },
+            { "index wpm", !back.load(zero_wpm), "an index with 0 wpm loaded" },
+            { "index channels", !back.load(no_channels), "an index with 0 channels loaded" },
+        };
+        char row[64];
+        snprintf(row, sizeof row, "%9.2lf %6.1lf %8.0lf %3d %5s", 700.0, 20.0, 8000.0, 1, "");
+        report(checks, sizeof checks / sizeof checks[0], row, " (timing index)");
+    }
+
+private:
+    /**
+    * Record mode: a record of RECORDS_MAX bytes converts, one byte more
+    * stops the run, for newline and length prefix framing
+    */
+    void records()
+    {
+        string longest(RECORDS_MAX, 'e'), out;
+        uint32_t len = RECORDS_MAX + 1;
+        string prefix((const char*)&len, 4);
+        MorseRecords lines(M, MorsePipe::ENCODE, MorseRecords::LINE);
+        bool at_max = lines.run(longest + "\n", out) && out.size() == 2 * (size_t)RECORDS_MAX;
+        MorseRecords longer(M, MorsePipe::ENCODE, MorseRecords::LINE);
+        MorseRecords prefixed(M, MorsePipe::ENCODE, MorseRecords::LENGTH);
+        const Check checks[] = {
+            { "record max", at_max, "a record of RECORDS_MAX bytes did not convert" },
+            { "record max+1", !longer.run(longest + "e\n", out), "a record of RECORDS_MAX + 1 bytes converted" },
+            { "record prefix", !prefixed.run(prefix + longest + "e", out), "a length prefix of RECORDS_MAX + 1 was read" },
+        };
+        char row[64];
+        snprintf(row, sizeof row, "%9s %6s %8s %3s %5s", "", "", "", "", "");
+        report(checks, sizeof checks / sizeof checks[0], row, " (record mode)");
+    }
+
+private:
+    /**
+    * Beam search decoder against the hard decoder on keying from the radio
+    * channel (jitter and noise, Goertzel front end): character error rate
+    * and cost per beam width, without and with the dictionary and bigram
+    * priors. The clean channel must decode exactly (a cell).
+    */
+    void beam_report()
+    {
+        static const char* words[] = { "CQ", "DE", "K", "TEST", "QRZ", "RST", "599", "73", "TU", "UR", "NAME", "QTH",
+            "PARIS", "LONDON", "DL1ABC", "G4XYZ", "F5KTR", "ON4UN", "W1AW", "JA1NUT", "RIG", "ANT", "WX", "FB" };
+        const int n_words = sizeof words / sizeof words[0];
+        const double hz = 700.0, wpm = 20.0, sps = 8000.0;
+        mt19937 rng(7);
+        auto sentence = [&](int count) {
+            string str = "";
+            for (int i = 0; i < count; i++) str += string(i > 0 ? " " : "") + words[rng() % n_words];
+            return str;
+        };
+        string dictionary = "", corpus = "";
+        for (int i = 0; i < n_words; i++) dictionary += string(words[i]) + " ";
+        for (int i = 0; i < 2000; i++) corpus += sentence(8) + "\n";
+        vector<string> texts;
+        for (int i = 0; i < 12; i++) texts.push_back(sentence(10));
+        // clean keying, every width
+        bool clean_ok = true;
+        for (const string& text : texts)
+        {
+            MorseWav mw(M.morse_encode(text).c_str(), hz, wpm, sps, 1);
+            vector<float> runs = MorseBeam::durations(mw.get_pcm_data(), mw.get_pcm_count(), 1, sps, hz, wpm);
+            for (int width : { 1, 16 })
+            {
+                MorseBeam::Params params;
+                params.beam = width;
+                MorseBeam beam(morse_table_itu, params);
+                if (beam_decode(beam, runs) != text) clean_ok = false;
+            }
+        }
+        const Check check = { "beam", clean_ok, "clean keying did not decode to the text at every beam width" };
+        char row[64];
+        snprintf(row, sizeof row, "%9.2lf %6.1lf %8.0lf %3d %5s", hz, wpm, sps, 1, "");
+        report(&check, 1, row, " (beam decoder, clean)");
+        // radio channel
+        for (double jitter : { 0.2, 0.3 }) beam_channel(texts, dictionary, corpus, 0.0, jitter);
+    }
+
+    /**
+    * One channel condition of the beam report
+    *
+    * @param texts
+    * @param dictionary - words of the dictionary prior
+    * @param corpus - text of the bigram prior
+    * @param snr
+    * @param jitter
+    */
+    void beam_channel(const vector<string>& texts, const string& dictionary, const string& corpus, double snr, double jitter)
+    {
+        const double hz = 700.0, wpm = 20.0, sps = 8000.0;
+        MorseChannel::Params noisy;
+        noisy.snr = snr; noisy.jitter = jitter;
+        vector<vector<float>> keyed;
+        double audio = 0.0;
+        size_t chars = 0;
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            MorseChannel ch(noisy, (unsigned long)i + 1);
+            MorseWav mw(M.morse_encode(texts[i]).c_str(), hz, wpm, sps, 1, NULL, false, &ch);
+            keyed.push_back(MorseBeam::durations(mw.get_pcm_data(), mw.get_pcm_count(), 1, sps, hz, wpm));
+            audio += mw.get_pcm_count() / sps;
+            chars += texts[i].size();
+        }
+        printf("\nbeam decoder, %.0lf dB snr, %.2lf elements jitter, %zu messages, %.1lf s of audio:\n", noisy.snr, noisy.jitter, texts.size(), audio);
+        printf("%-12s %6s %8s %14s %10s %12s\n", "decoder", "beam", "cer %", "hypotheses", "ms", "x real time");
+        size_t errors = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (size_t i = 0; i < texts.size(); i++) errors += distance(hard_decode(keyed[i]), texts[i]);
+        double t = seconds(t0, chrono::steady_clock::now());
+        printf("%-12s %6s %8.2lf %14s %10.3lf %12.0lf\n", "hard", "", 100.0 * errors / chars, "", 1e3 * t, t > 0 ? audio / t : 0.0);
+        for (int prior = 0; prior < 2; prior++)
+        {
+            for (int width : { 1, 4, 16, 64, 256 })
+            {
+                MorseBeam::Params params;
+                params.beam = width;
+                MorseBeam beam(morse_table_itu, params);
+                if (prior)
+                {
+                    beam.dictionary(dictionary);
+                    beam.train(corpus);
+                }
+                errors = 0;
+                t0 = chrono::steady_clock::now();
+                for (size_t i = 0; i < texts.size(); i++) errors += distance(beam_decode(beam, keyed[i]), texts[i]);
+                t = seconds(t0, chrono::steady_clock::now());
+                printf("%-12s %6d %8.2lf %14lld %10.3lf %12.0lf\n", prior ? "beam+priors" : "beam", width, 100.0 * errors / chars,
+                    beam.expanded(), 1e3 * t, t > 0 ? audio / t : 0.0);
+            }
+        }
+    }
+
+    string beam_decode(MorseBeam& beam, const vector<float>& runs)
+    {
+        for (float run : runs)
+        {
+            if (run > 0) beam.mark(run);
+            else beam.space(-run);
+        }
+        return beam.finish();
+    }
+
+    /**
+    * Hard decisions: mark of 2 elements or more is a dah, space of 2 or more
+    * ends a letter, of 4 or more a word, unknown codes become *
+    */
+    string hard_decode(const vector<float>& runs)
+    {
+        string text = "";
+        uint32_t code = 1;
+        for (size_t i = 0; i <= runs.size(); i++)
+        {
+            float run = i < runs.size() ? runs[i] : -9.0f;
+            if (run > 0)
+            {
+                if (code < MorseTable::CODES) code = (code << 1) | (run >= 2.0f);
+                continue;
+            }
+            if (run > -2.0f) continue;
+            int sym = morse_table_itu.symbol(code);
+            text += sym >= 0 ? morse_table_itu.text[sym] : "*";
+            if (run <= -4.0f && i < runs.size()) text += " ";
+            code = 1;
+        }
+        return text;
+    }
+
+    /**
+    * Edit distance (bytes)
+    */
+    static size_t distance(const string& a, const string& b)
+    {
+        vector<size_t> row(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); j++) row[j] = j;
+        for (size_t i = 1; i <= a.size(); i++)
+        {
+            size_t diag = row[0];
+            row[0] = i;
+            for (size_t j = 1; j <= b.size(); j++)
+            {
+                size_t up = row[j];
+                row[j] = min(min(row[j] + 1, row[j - 1] + 1), diag + (a[i - 1] != b[j - 1]));
+                diag = up;
+            }
+        }
+        return row[b.size()];
+    }
+
+private:
+    /**
+    * Pull the morse from a MorseStream in blocks of 997 frames and compare
+    * with the samples MorseWav rendered
+    *
+    * @param morse
+    * @param mw
+    * @param hz
+    * @param wpm
+    * @param sps
+    * @param channels
+    * @param nco
+    * @return bool
+    */
+    bool stream_same(const string& morse, const MorseWav& mw, double hz, double wpm, double sps, int channels, bool nco)
+    {
+        const long block = 997;
+        MorseStream ms(morse, hz, wpm, sps, channels, nco);
+        int16_t out[block * 2];
+        const int16_t* pcm = mw.get_pcm_data();
+        bool same = ms.frames() == mw.get_pcm_count();
+        for (long pos = 0; same && !ms.done(); pos += block)
+        {
+            long n = ms.fill(out, block);
+            same = memcmp(out, pcm + pos * channels, n * channels * sizeof(int16_t)) == 0;
+            for (long i = n * channels; same && i < block * channels; i++) same = out[i] == 0;
+        }
+        return same && ms.position() == mw.get_pcm_count();
+    }
+
+private:
+    /**
+    * Compare fixed-point and floating-point synthesis of the same morse
+    *
+    * @param nco
+    * @param mw
+    * @param channels
+    * @return double - rms difference in LSB, 1e9 when the lengths differ
+    */
+    double nco_difference(const MorseWav& nco, const MorseWav& mw, int channels)
+    {
+        if (nco.get_pcm_count() != mw.get_pcm_count()) return 1e9;
+        const int16_t* a = nco.get_pcm_data();
+        const int16_t* b = mw.get_pcm_data();
+        long count = mw.get_pcm_count() * channels;
+        double sum = 0;
+        for (long i = 0; i < count; i++)
+        {
+            int d = abs(a[i] - b[i]);
+            if (d > nco_max) nco_max = d;
+            sum += (double)d * d;
+        }
+        double rms = count > 0 ? sqrt(sum / count) : 0.0;
+        if (rms > nco_rms) nco_rms = rms;
+        return rms;
+    }
+
+private:
+    /**
+    * Decode rendered PCM back to morse code (. - space).
+    * Grid-synchronous envelope detector: one decision per morse element (quantum),
+    * then runs of marks/spaces are mapped to dit, dah, letter gap and word gap.
+    *
+    * @param pcm
+    * @param count
+    * @param channels
+    * @param n - samples per element
+    * @return string
+    */
+    string audio_decode(const int16_t* pcm, long count, int channels, long n)
+    {
+        string morse = "";
+        int on = 0, run = 0;
+        long quanta = n > 0 ? count / n : 0;
+        for (long q = 0; q <= quanta; q++)
+        {
+            int state = 0;
+            if (q < quanta)
+            {
+                for (long i = q * n; i < (q + 1) * n; i++)
+                {
+                    if (abs(pcm[i * channels]) > 16000) { state = 1; break; }
+                }
+            }
+            if (q > 0 && (state != on || q == quanta))
+            {
+                if (on) morse += run >= 3 ? "-" : ".";
+                else for (int k = 0; q < quanta && k < (run - 1) / 2; k++) morse += " ";
+                run = 0;
+            }
+            on = state;
+            run++;
+        }
+        return morse;
+    }
+
+private:
+    /**
+    * Random words from the morse table, lower and upper case,
+    * empty when the table has no characters
+    *
+    * @return string
+    */
+    string random_text()
+    {
+        if (Charset.empty()) return ""; // no character of the table decodes to itself
+        uniform_int_distribution<size_t> pick(0, Charset.size() - 1);
+        uniform_int_distribution<int> word(1, 7);
+        string str = "";
+        while ((long)str.size() < Chars)
+        {
+            if (!str.empty()) str += " ";
+            for (int i = word(Rng); i > 0; i--)
+            {
+                const string& c = Charset[pick(Rng)];
+                str += (Rng() & 1) && c.size() == 1 ? string(1, (char)tolower(c[0])) : c;
+            }
+        }
+        return str;
+    }
+
+    string upper(string str)
+    {
+        for (auto& c : str) c = (char)toupper((unsigned char)c);
+        return str;
+    }
+
+    static double seconds(chrono::steady_clock::time_point a, chrono::steady_clock::time_point b)
+    {
+        return chrono::duration<double>(b - a).count();
+    }
+
+    void print_stage(const char* name, double t, double n, const char* unit)
+    {
+        printf("%-14s %12.0lf %-7s %9.3lf s %14.0lf %s/s\n", name, n, unit, t, t > 0 ? n / t : 0.0, unit);
+    }
+};
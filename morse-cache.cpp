@@ -0,0 +1,117 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+/**
+* C++ MorseWavCache Class file used by morse-wav.cpp
+* Bounded LRU cache of rendered PCM per morse word, keyed by the word's
+* code and the tone, wpm, sps and channel layout it was rendered with.
+*
+* MorseWav starts every morse element at phase 0, so a word renders to the
+* same samples wherever it sits in a message and a cached copy joins its
+* neighbours without a seam. One cache can be shared by several MorseWav
+* objects and threads.
+*
+* It pays off only where the same text is rendered again: the files of an
+* ew batch (-count:n) and the rt bench. A single render (ew, ew -index,
+* beacons, the server, which streams) goes without it, there it would
+* only add a lock and a copy per word.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseWavCache
+{
+public:
+    typedef shared_ptr<const vector<int16_t>> Pcm;
+
+    /**
+    * Instance variables
+    */
+private:
+    size_t MaxBytes;                            // bound of cached samples
+    size_t Bytes = 0;                           // cached samples now
+    list<pair<string, Pcm>> Lru;                // most recently used first
+    unordered_map<string, list<pair<string, Pcm>>::iterator> Index;
+    mutex Lock;
+    atomic<uint64_t> Hits, Misses;
+
+public:
+    /**
+    * Constructor
+    *
+    * @param max_bytes
+    */
+    MorseWavCache(size_t max_bytes = 64 << 20) : MaxBytes(max_bytes), Hits(0), Misses(0) {}
+
+public:
+    /**
+    * Get the samples of a word, NULL when not cached
+    *
+    * @param key
+    * @return Pcm
+    */
+    Pcm get(const string& key)
+    {
+        lock_guard<mutex> guard(Lock);
+        auto it = Index.find(key);
+        if (it == Index.end())
+        {
+            Misses++;
+            return NULL;
+        }
+        Hits++;
+        Lru.splice(Lru.begin(), Lru, it->second);
+        return it->second->second;
+    }
+
+    /**
+    * Add the samples of a word, dropping least recently used words to stay in bounds
+    *
+    * @param key
+    * @param pcm
+    */
+    void put(const string& key, Pcm pcm)
+    {
+        size_t size = pcm->size() * sizeof(int16_t);
+        if (size > MaxBytes / 4) return;
+        lock_guard<mutex> guard(Lock);
+        if (Index.find(key) != Index.end()) return;
+        Lru.emplace_front(key, pcm);
+        Index[key] = Lru.begin();
+        Bytes += size;
+        while (Bytes > MaxBytes)
+        {
+            Bytes -= Lru.back().second->size() * sizeof(int16_t);
+            Index.erase(Lru.back().first);
+            Lru.pop_back();
+        }
+    }
+
+public:
+    /**
+    * Counters
+    */
+    uint64_t hits() { return Hits; }
+    uint64_t misses() { return Misses; }
+
+    size_t bytes()
+    {
+        lock_guard<mutex> guard(Lock);
+        return Bytes;
+    }
+
+    size_t words()
+    {
+        lock_guard<mutex> guard(Lock);
+        return Lru.size();
+    }
+};
@@ -0,0 +1,259 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+using namespace std;
+/**
+* C++ MorseChannel Class file used by morse-wav.cpp
+* Radio channel simulator for test corpora: white gaussian noise at a
+* target SNR, QSB (slow fading), frequency drift and keying jitter.
+*
+* Noise and fading are applied to the rendered PCM, drift and jitter are
+* asked for by MorseWav while it synthesizes. Everything random comes from
+* one seeded generator, so a seed always renders the same file.
+*
+* SNR is the key-down tone power against the noise power over the whole
+* band (0 .. sps / 2), in dB.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseChannel
+{
+public:
+    /**
+    * Channel settings, off by default
+    */
+    struct Params
+    {
+        double snr = HUGE_VAL;  // dB, -snr:<dB>
+        double qsb = 0.0;       // fading depth 0..1, -qsb:<depth>[,<hz>]
+        double qsb_hz = 0.2;    // fading rate
+        double drift = 0.0;     // tone drift in Hz per second, -drift:<hz/s>
+        double jitter = 0.0;    // keying jitter, std dev in elements, -jitter:<elements>
+
+        bool active() const { return isfinite(snr) || qsb > 0.0 || drift != 0.0 || jitter > 0.0; }
+    };
+
+    /**
+    * xoshiro128** in 8 independent lanes. A whole block is generated at a time
+    * by a plain loop over the lanes, which the compiler turns into vector code.
+    */
+    class Random
+    {
+    private:
+#define RANDOM_LANES 8
+#define RANDOM_BLOCK 256
+        uint32_t S0[RANDOM_LANES], S1[RANDOM_LANES], S2[RANDOM_LANES], S3[RANDOM_LANES];
+        uint32_t Block[RANDOM_BLOCK];
+        int Next = RANDOM_BLOCK;
+
+    public:
+        Random(uint64_t seed)
+        {
+            // splitmix64 seeding, as recommended for the xoshiro family
+            for (int j = 0; j < RANDOM_LANES; j++)
+            {
+                uint64_t a = splitmix(seed), b = splitmix(seed);
+                S0[j] = (uint32_t)a; S1[j] = (uint32_t)(a >> 32);
+                S2[j] = (uint32_t)b; S3[j] = (uint32_t)(b >> 32);
+            }
+        }
+
+        uint32_t next()
+        {
+            if (Next == RANDOM_BLOCK) refill();
+            return Block[Next++];
+        }
+
+        /**
+        * Uniform in (0, 1)
+        */
+        double uniform() { return ((next() >> 8) + 0.5) * (1.0 / 16777216.0); }
+
+    private:
+        void refill()
+        {
+            for (int k = 0; k < RANDOM_BLOCK; k += RANDOM_LANES)
+            {
+                for (int j = 0; j < RANDOM_LANES; j++)
+                {
+                    Block[k + j] = rotl(S1[j] * 5, 7) * 9;
+                    uint32_t t = S1[j] << 9;
+                    S2[j] ^= S0[j];
+                    S3[j] ^= S1[j];
+                    S1[j] ^= S2[j];
+                    S0[j] ^= S3[j];
+                    S2[j] ^= t;
+                    S3[j] = rotl(S3[j], 11);
+                }
+            }
+            Next = 0;
+        }
+
+        static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+        static uint64_t splitmix(uint64_t& x)
+        {
+            uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+    };
+
+    /**
+    * Instance variables
+    */
+private:
+#define CHANNEL_BLOCK 64    // frames per fading step
+    Params P;
+    Random Rng;
+    double QsbPhase;        // random start of the fading cycle
+    // ziggurat tables (Marsaglia and Tsang), 128 layers
+    uint32_t Kn[128];
+    float Wn[128], Fn[128];
+
+public:
+    /**
+    * Constructor
+    *
+    * @param params
+    * @param seed
+    */
+    MorseChannel(const Params& params, uint64_t seed) : P(params), Rng(seed)
+    {
+        QsbPhase = 6.283185307179586 * Rng.uniform();
+        double dn = 3.442619855899, tn = dn, vn = 9.91256303526217e-3, m1 = 2147483648.0;
+        double q = vn / exp(-0.5 * dn * dn);
+        Kn[0] = (uint32_t)((dn / q) * m1);
+        Kn[1] = 0;
+        Wn[0] = (float)(q / m1);
+        Wn[127] = (float)(dn / m1);
+        Fn[0] = 1.0f;
+        Fn[127] = (float)exp(-0.5 * dn * dn);
+        for (int i = 126; i >= 1; i--)
+        {
+            dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+            Kn[i + 1] = (uint32_t)((dn / tn) * m1);
+            tn = dn;
+            Fn[i] = (float)exp(-0.5 * dn * dn);
+            Wn[i] = (float)(dn / m1);
+        }
+    }
+
+public:
+    /**
+    * Get a standard normal sample, ziggurat: one multiply and compare
+    * in about 99 of 100 calls.
+    *
+    * @return float
+    */
+    float normal()
+    {
+        int32_t hz = (int32_t)Rng.next();
+        uint32_t iz = hz & 127;
+        if ((uint32_t)(hz < 0 ? -(int64_t)hz : hz) < Kn[iz]) return hz * Wn[iz];
+        return normal_slow(hz, iz);
+    }
+
+public:
+    /**
+    * Get the tone frequency at a point of the message (drift)
+    *
+    * @param tone
+    * @param seconds
+    * @return double
+    */
+    double frequency(double tone, double seconds) const
+    {
+        return tone + P.drift * seconds;
+    }
+
+    /**
+    * Get the length of one keyed quantum (jitter)
+    *
+    * @param n - samples without jitter
+    * @return long
+    */
+    long quantum(long n)
+    {
+        if (P.jitter <= 0.0) return n;
+        long j = n + lround(normal() * P.jitter * n);
+        return j < 1 ? 1 : j;
+    }
+
+    /**
+    * Rendering depends on the position in the message (no word caching)
+    *
+    * @return bool
+    */
+    bool timing() const { return P.drift != 0.0 || P.jitter > 0.0; }
+
+public:
+    /**
+    * Apply fading and noise to rendered PCM, in place
+    *
+    * @param pcm - interleaved samples
+    * @param frames
+    * @param channels
+    * @param sps
+    * @param amplitude - of the key-down tone
+    */
+    void apply(int16_t* pcm, long frames, int channels, double sps, double amplitude)
+    {
+        float sigma = isfinite(P.snr) ? (float)(amplitude / sqrt(2.0) * pow(10.0, -P.snr / 20.0)) : 0.0f;
+        float noise[CHANNEL_BLOCK];
+        double w = 6.283185307179586 * P.qsb_hz / sps;
+        for (long start = 0; start < frames; start += CHANNEL_BLOCK)
+        {
+            long n = frames - start < CHANNEL_BLOCK ? frames - start : CHANNEL_BLOCK;
+            // fading gain, linear within the block
+            float g0 = gain(w * start), g1 = gain(w * (start + n));
+            float dg = (g1 - g0) / n;
+            for (long i = 0; i < n; i++) noise[i] = sigma > 0.0f ? sigma * normal() : 0.0f;
+            int16_t* p = pcm + start * channels;
+            for (long i = 0; i < n; i++)
+            {
+                float g = g0 + dg * i;
+                for (int c = 0; c < channels; c++)
+                {
+                    float v = p[i * channels + c] * g + noise[i];
+                    p[i * channels + c] = (int16_t)(v > 32767.0f ? 32767.0f : v < -32768.0f ? -32768.0f : v);
+                }
+            }
+        }
+    }
+
+private:
+    float gain(double phase) const
+    {
+        if (P.qsb <= 0.0) return 1.0f;
+        return (float)(1.0 - P.qsb * (0.5 + 0.5 * sin(phase + QsbPhase)));
+    }
+
+    float normal_slow(int32_t hz, uint32_t iz)
+    {
+        const float r = 3.442620f;
+        while (true)
+        {
+            float x = hz * Wn[iz];
+            if (iz == 0)
+            {
+                float y;
+                do
+                {
+                    x = (float)(-log(Rng.uniform()) * 0.2904764);
+                    y = (float)-log(Rng.uniform());
+                } while (y + y < x * x);
+                return hz > 0 ? r + x : -r - x;
+            }
+            if (Fn[iz] + Rng.uniform() * (Fn[iz - 1] - Fn[iz]) < exp(-0.5 * x * x)) return x;
+            hz = (int32_t)Rng.next();
+            iz = hz & 127;
+            if ((uint32_t)(hz < 0 ? -(int64_t)hz : hz) < Kn[iz]) return hz * Wn[iz];
+        }
+    }
+};
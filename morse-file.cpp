@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <windows.h>
+
+using namespace std;
+/**
+* C++ MorseFile Class file used by morse.cpp
+* Read-only memory mapped input file, for decoding huge morse text captures
+* without read copies, and a large reusable output buffer.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseFile
+{
+    /**
+    * Instance variables
+    */
+private:
+    HANDLE File = INVALID_HANDLE_VALUE;
+    HANDLE Map = NULL;
+    const char* Data = NULL;   // mapped view
+    size_t Size = 0;           // bytes in view
+    size_t Prefetched = 0;     // bytes handed to PrefetchVirtualMemory so far
+
+public:
+    /**
+    * Constructor, map the whole file read-only.
+    * FILE_FLAG_SEQUENTIAL_SCAN and chunked PrefetchVirtualMemory are the
+    * Windows counterparts of madvise(MADV_SEQUENTIAL / MADV_WILLNEED).
+    *
+    * @param path
+    */
+    MorseFile(const char* path)
+    {
+        File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (File == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(File, &size) || size.QuadPart == 0) return; // empty files can not be mapped
+        Map = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (Map == NULL) return;
+        Data = (const char*)MapViewOfFile(Map, FILE_MAP_READ, 0, 0, 0);
+        if (Data != NULL) Size = (size_t)size.QuadPart;
+    }
+
+    MorseFile(const MorseFile&) = delete;
+    MorseFile& operator=(const MorseFile&) = delete;
+
+    /**
+    * Destructor
+    */
+    ~MorseFile()
+    {
+        if (Data != NULL) UnmapViewOfFile(Data);
+        if (Map != NULL) CloseHandle(Map);
+        if (File != INVALID_HANDLE_VALUE) CloseHandle(File);
+    }
+
+public:
+    /**
+    * File opened (and mapped when not empty)
+    *
+    * @return bool
+    */
+    bool ok() { return File != INVALID_HANDLE_VALUE && (Data != NULL || Map == NULL); }
+
+    /**
+    * Get the mapped bytes
+    *
+    * @return string_view
+    */
+    string_view view() { return string_view(Data != NULL ? Data : "", Size); }
+
+    /**
+    * Get a part of the mapped bytes and ask the memory manager to read ahead
+    * the part after it, so page faults are served from cache.
+    *
+    * @param offset
+    * @param count
+    * @return string_view
+    */
+    string_view chunk(size_t offset, size_t count)
+    {
+        if (offset >= Size) return string_view();
+        if (count > Size - offset) count = Size - offset;
+        size_t ahead = offset + 2 * count < Size ? offset + 2 * count : Size;
+        if (ahead > Prefetched)
+        {
+            WIN32_MEMORY_RANGE_ENTRY range;
+            range.VirtualAddress = (PVOID)(Data + Prefetched);
+            range.NumberOfBytes = ahead - Prefetched;
+            PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            Prefetched = ahead;
+        }
+        return string_view(Data + offset, count);
+    }
+};
+
+/**
+* Large reusable output buffer: callers append to text(), flush() writes
+* it with one call when full and keeps the capacity for the next round.
+*/
+class MorseOut
+{
+private:
+    FILE* Out;
+    string Buffer;
+    size_t Limit;
+
+public:
+    /**
+    * Constructor
+    *
+    * @param out
+    * @param limit - flush threshold in bytes
+    */
+    MorseOut(FILE* out, size_t limit = 4 << 20) : Out(out), Limit(limit)
+    {
+        Buffer.reserve(limit + (limit >> 2));
+    }
+
+    ~MorseOut() { flush(); }
+
+public:
+    /**
+    * Get buffer to append to
+    *
+    * @return string&
+    */
+    string& text() { return Buffer; }
+
+    /**
+    * Write buffer when over the threshold (or always when forced)
+    *
+    * @param force
+    * @return bool - false on write error
+    */
+    bool flush(bool force = true)
+    {
+        if (Buffer.empty() || (!force && Buffer.size() < Limit)) return true;
+        bool ok = fwrite(Buffer.data(), Buffer.size(), 1, Out) == 1;
+        Buffer.clear();
+        return ok;
+    }
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+/**
+* C++ MorseIndex Class file used by morse-wav.cpp
+* Timing index of a rendered WAV file: the first sample of every morse
+* symbol (character) and every word, written next to the WAV as <wav>.idx.
+* Players and decoders find the word or character at any time with a
+* binary search, and the e-patch modus (ep) re-renders only the words
+* that changed.
+*
+* The first sample of a word is the start of the gap before it (the first
+* word starts at 0), so the words tile the whole file. With the phase reset
+* at every quantum, a word renders to the same samples on its own as in the
+* whole message.
+*
+* File format, integers and doubles little endian:
+* "MIDX", u32 version, u32 flags, u32 channels, f64 tone, f64 wpm, f64 sps,
+* u32 frames, u32 symbols, u32 words, u32 morse size,
+* u32 symbol sample[symbols], u32 symbol code[symbols] (offset in the morse),
+* u32 word symbol[words] (first symbol), u32 word sample[words], morse text
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseIndex
+{
+public:
+    enum
+    {
+        VERSION = 1,
+        NCO = 1,        // fixed-point synthesis
+        CHANNEL = 2     // rendered through the radio channel, not reproducible
+    };
+
+    uint32_t flags = 0;
+    uint32_t channels = 1;
+    double tone = 0.0;
+    double wpm = 0.0;
+    double sps = 0.0;
+    long frames = 0;                    // PCM samples of the file
+    string morse;                       // morse text rendered
+    vector<uint32_t> symbol_sample;     // first sample of a symbol
+    vector<uint32_t> symbol_code;       // offset of its code in morse
+    vector<uint32_t> word_symbol;       // first symbol of a word
+    vector<uint32_t> word_sample;       // first sample of a word, gap before it included
+
+public:
+    /**
+    * Recording, called by MorseWav while it renders
+    */
+    void clear()
+    {
+        morse.clear();
+        symbol_sample.clear();
+        symbol_code.clear();
+        word_symbol.clear();
+        word_sample.clear();
+    }
+
+    void add_word(long sample)
+    {
+        word_symbol.push_back((uint32_t)symbol_sample.size());
+        word_sample.push_back((uint32_t)sample);
+    }
+
+    void add_symbol(long sample, size_t code)
+    {
+        symbol_sample.push_back((uint32_t)sample);
+        symbol_code.push_back((uint32_t)code);
+    }
+
+public:
+    /**
+    * Get the word at a sample, O(log n)
+    *
+    * @param sample
+    * @return int - word, -1 when there are no words
+    */
+    int find_word(long sample) const
+    {
+        return (int)(upper_bound(word_sample.begin(), word_sample.end(), (uint32_t)sample) - word_sample.begin()) - 1;
+    }
+
+    /**
+    * Get the symbol sounding (or the last one before the gap) at a sample, O(log n)
+    *
+    * @param sample
+    * @return int - symbol, -1 before the first one
+    */
+    int find_symbol(long sample) const
+    {
+        return (int)(upper_bound(symbol_sample.begin(), symbol_sample.end(), (uint32_t)sample) - symbol_sample.begin()) - 1;
+    }
+
+    /**
+    * Get the first sample of a word, the end of the file after the last word
+    *
+    * @param word
+    * @return long
+    */
+    long word_start(int word) const
+    {
+        return word < (int)word_sample.size() ? (long)word_sample[word] : frames;
+    }
+
+    /**
+    * Get the code of a symbol
+    *
+    * @param symbol
+    * @return string_view
+    */
+    string_view code(int symbol) const
+    {
+        size_t start = symbol_code[symbol], end = morse.find(' ', start);
+        return string_view(morse).substr(start, end == string::npos ? string::npos : end - start);
+    }
+
+public:
+    /**
+    * Index of a patched file: the words before first and from last on
+    * come from the old index (moved by the change of length), the words
+    * in between from the index of the re-rendered part.
+    *
+    * @param old
+    * @param first - first word replaced
+    * @param last - first old word kept after the replaced ones
+    * @param part - index of the rendered words, with the gap before them
+    * @param text - morse text of the whole patched file
+    */
+    void patch(const MorseIndex& old, int first, int last, const MorseIndex& part, const string& text)
+    {
+        long from = old.word_start(first), to = old.word_start(last);
+        long delta = part.frames - (to - from);
+        clear();
+        flags = old.flags;
+        channels = old.channels;
+        tone = old.tone;
+        wpm = old.wpm;
+        sps = old.sps;
+        frames = old.frames + delta;
+        morse = text;
+        copy_words(old, 0, first, 0);
+        copy_words(part, 0, (int)part.word_sample.size(), from);
+        copy_words(old, last, (int)old.word_sample.size(), delta);
+        // codes: offsets of the symbol starts in the new morse text
+        for (size_t i = 0; i < morse.size(); i++)
+        {
+            if ((morse[i] == '.' || morse[i] == '-') && (i == 0 || morse[i - 1] == ' ')) symbol_code.push_back((uint32_t)i);
+        }
+        symbol_code.resize(symbol_sample.size());
+    }
+
+private:
+    void copy_words(const MorseIndex& from, int first, int last, long shift)
+    {
+        for (int w = first; w < last; w++)
+        {
+            add_word(from.word_sample[w] + shift);
+            uint32_t end = w + 1 < (int)from.word_symbol.size() ? from.word_symbol[w + 1] : (uint32_t)from.symbol_sample.size();
+            for (uint32_t k = from.word_symbol[w]; k < end; k++) symbol_sample.push_back((uint32_t)(from.symbol_sample[k] + shift));
+        }
+    }
+
+public:
+    /**
+    * Write the index
+    *
+    * @param path
+    * @return bool
+    */
+    bool save(const string& path) const
+    {
+        FILE* file;
+#pragma warning(suppress : 4996)
+        if ((file = fopen(path.c_str(), "wb")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", path.c_str());
+            return false;
+        }
+        string data = bytes();
+        bool ok = fwrite(data.data(), data.size(), 1, file) == 1;
+        if (fclose(file) != 0) ok = false;
+        if (!ok) fprintf(stderr, "Write failed: %s\n", path.c_str());
+        return ok;
+    }
+
+    /**
+    * Get the index as file bytes
+    *
+    * @return string
+    */
+    string bytes() const
+    {
+        string data = "MIDX";
+        uint32_t u[] = { VERSION, flags, channels };
+        double d[] = { tone, wpm, sps };
+        uint32_t n[] = { (uint32_t)frames, (uint32_t)symbol_sample.size(), (uint32_t)word_sample.size(), (uint32_t)morse.size() };
+        data.append((const char*)u, sizeof u);
+        data.append((const char*)d, sizeof d);
+        data.append((const char*)n, sizeof n);
+        append(data, symbol_sample);
+        append(data, symbol_code);
+        append(data, word_symbol);
+        append(data, word_sample);
+        data += morse;
+        return data;
+    }
+
+    /**
+    * Read an index
+    *
+    * @param data - file bytes
+    * @return bool - false when it is not a valid index
+    */
+    bool load(string_view data)
+    {
+        const size_t head_size = 4 + 3 * 4 + 3 * 8 + 4 * 4;
+        if (data.size() < head_size || data.compare(0, 4, "MIDX") != 0) return false;
+        uint32_t u[3], n[4];
+        double d[3];
+        memcpy(u, data.data() + 4, sizeof u);
+        memcpy(d, data.data() + 16, sizeof d);
+        memcpy(n, data.data() + 40, sizeof n);
+        if (u[0] != VERSION || data.size() != head_size + 8 * ((size_t)n[1] + n[2]) + n[3]) return false;
+        flags = u[1]; channels = u[2];
+        tone = d[0]; wpm = d[1]; sps = d[2];
+        frames = (long)n[0];
+        const char* p = data.data() + head_size;
+        read(p, symbol_sample, n[1]);
+        read(p, symbol_code, n[1]);
+        read(p, word_symbol, n[2]);
+        read(p, word_sample, n[2]);
+        morse.assign(p, n[3]);
+        return valid();
+    }
+
+private:
+    /**
+    * Check a loaded index: the settings within the cmd line limits (see
+    * Morse, clamped by get_options, so every index written loads), the
+    * lists ascending, the first word on the first symbol, every word on a
+    * symbol, every symbol on a code of the morse text, every sample in the file
+    *
+    * @return bool
+    */
+    bool valid() const
+    {
+        if (channels < 1 || channels > 2 || !in_range(tone, 37.0, 8000.0) || !in_range(wpm, 1.0, 50.0) || !in_range(sps, 8000.0, 48000.0))
+            return false;
+        if (!word_symbol.empty() && word_symbol[0] != 0) return false;
+        if (!is_sorted(symbol_sample.begin(), symbol_sample.end()) || !is_sorted(symbol_code.begin(), symbol_code.end()) ||
+            !is_sorted(word_symbol.begin(), word_symbol.end()) || !is_sorted(word_sample.begin(), word_sample.end()))
+            return false;
+        if (!symbol_code.empty() && symbol_code.back() >= morse.size()) return false;
+        if (!word_symbol.empty() && word_symbol.back() > symbol_sample.size()) return false;
+        if (!symbol_sample.empty() && symbol_sample.back() > (uint32_t)frames) return false;
+        if (!word_sample.empty() && word_sample.back() > (uint32_t)frames) return false;
+        return true;
+    }
+
+    static bool in_range(double v, double low, double high)
+    {
+        return isfinite(v) && v >= low && v <= high;
+    }
+
+public:
+    /**
+    * Split morse text into words (runs of two or more spaces between them)
+    *
+    * @param morse
+    * @return vector<string_view>
+    */
+    static vector<string_view> words(string_view morse)
+    {
+        vector<string_view> list;
+        for (size_t pos = 0; pos < morse.size();)
+        {
+            size_t end = morse.find("  ", pos);
+            if (end == string_view::npos) end = morse.size();
+            if (end > pos) list.push_back(morse.substr(pos, end - pos));
+            pos = morse.find_first_not_of(' ', end);
+            if (pos == string_view::npos) break;
+        }
+        return list;
+    }
+
+private:
+    static void append(string& data, const vector<uint32_t>& v)
+    {
+        data.append((const char*)v.data(), v.size() * sizeof(uint32_t));
+    }
+
+    static void read(const char*& p, vector<uint32_t>& v, uint32_t n)
+    {
+        v.resize(n);
+        if (n > 0) memcpy(v.data(), p, n * sizeof(uint32_t));
+        p += n * sizeof(uint32_t);
+    }
+};
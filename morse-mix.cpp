@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+/**
+* C++ MorseMix Class file used by morse.cpp
+* Frequency-division multiplexed rendering: many messages, each with its own
+* tone, wpm and gain, mixed into one mono WAV file in a single pass. Crowded
+* band files for loading decoders and skimmers.
+*
+* Every message is a voice with its own nco (continuous phase, it keeps
+* running through the gaps like a real transmitter) and its own keying state.
+* Voices render a block of MIX_BLOCK samples at a time into a Q15 buffer,
+* which is scaled and added to an int32 accumulator; the accumulator is
+* saturated to int16 once per block. Both loops are plain loops over arrays,
+* which the compiler vectorizes. The output is streamed, so the mix never
+* holds more than one block in memory.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseMix
+{
+public:
+    /**
+    * One message of the mix: <hz>,<wpm>[,<gain>]:<text>
+    */
+    struct Message
+    {
+        double hz = 880.0;
+        double wpm = 16.0;
+        double gain = 0.0;  // 0..1 of full scale, 0 for 1 / messages
+        string text;
+        string morse;       // text encoded by the caller
+    };
+
+    /**
+    * Instance variables
+    */
+private:
+#define MIX_BLOCK 4096  // samples per mixing block
+    struct Voice
+    {
+        const char* Code;   // morse, dots, dashes and spaces
+        long Quantum;       // samples per element
+        int32_t Ampl;       // amplitude, 32000 * gain
+        uint32_t Phase = 0; // nco
+        uint32_t Step;
+        long Left = 0;      // samples left in the current mark or gap
+        bool On = false;
+        int Rest = 0;       // elements of gap after the current mark
+        bool Done = false;
+    };
+    vector<Voice> Voices;
+    double Sps;
+    long Frames = 0;        // samples of the longest message
+    long Clipped = 0;       // samples saturated
+
+public:
+    /**
+    * Constructor
+    *
+    * @param messages - morse already encoded, kept by the caller while mixing
+    * @param sps
+    */
+    MorseMix(const vector<Message>& messages, double sps) : Sps(sps)
+    {
+        for (const Message& m : messages)
+        {
+            Voice v;
+            v.Code = m.morse.c_str();
+            v.Quantum = (long)(1.2 / m.wpm * sps); // same quantum as MorseWav
+            double gain = m.gain > 0.0 ? m.gain : 1.0 / messages.size();
+            v.Ampl = (int32_t)lround(32000.0 * (gain > 1.0 ? 1.0 : gain));
+            v.Step = MorseWav::nco_step(m.hz, sps);
+            long frames = 0;
+            for (const char* c = v.Code; *c != '\0'; c++)
+            {
+                if (*c == '.' || *c == ' ') frames += 2 * v.Quantum;
+                if (*c == '-') frames += 4 * v.Quantum;
+            }
+            if (frames > Frames) Frames = frames;
+            Voices.push_back(v);
+        }
+    }
+
+public:
+    /**
+    * Parse one message, <hz>,<wpm>[,<gain>]:<text>
+    *
+    * @param spec
+    * @param m
+    * @return bool
+    */
+    static bool parse(const string& spec, Message& m)
+    {
+        size_t colon = spec.find(':');
+        if (colon == string::npos) return false;
+        string head = spec.substr(0, colon);
+        int n = sscanf_s(head.c_str(), "%lf,%lf,%lf", &m.hz, &m.wpm, &m.gain);
+        if (n < 2 || m.hz <= 0.0 || m.wpm <= 0.0 || m.gain < 0.0) return false;
+        if (n == 2) m.gain = 0.0;
+        m.text = spec.substr(colon + 1);
+        return true;
+    }
+
+public:
+    /**
+    * Mix all messages into a mono WAV file
+    *
+    * @param path
+    * @return bool
+    */
+    bool write(const char* path)
+    {
+        auto start = chrono::steady_clock::now();
+        FILE* file;
+#pragma warning(suppress : 4996)
+        if ((file = fopen(path, "wb")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", path);
+            return false;
+        }
+        string header = MorseWav::wav_header(Frames, 1, Sps);
+        bool ok = fwrite(header.data(), header.size(), 1, file) == 1;
+        vector<int32_t> acc(MIX_BLOCK), wave(MIX_BLOCK);
+        vector<int16_t> out(MIX_BLOCK);
+        for (long done = 0; ok && done < Frames; done += MIX_BLOCK)
+        {
+            long n = Frames - done < MIX_BLOCK ? Frames - done : MIX_BLOCK;
+            mix_block(acc.data(), wave.data(), out.data(), n);
+            ok = fwrite(out.data(), n * sizeof(int16_t), 1, file) == 1;
+        }
+        if (fclose(file) != 0) ok = false;
+        if (!ok)
+        {
+            fprintf(stderr, "Write failed: %s\n", path);
+            return false;
+        }
+        double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double audio = Frames / Sps;
+        printf("%zu messages mixed, %ld PCM samples (%.1lf s @ %.1lf kHz) written to %s (%.1f kB)\n",
+            Voices.size(), Frames, audio, Sps / 1e3, path, (header.size() + Frames * sizeof(int16_t)) / 1024.0);
+        printf("%ld samples clipped, %.3lf s (%.0lfx real time)\n", Clipped, wall, wall > 0.0 ? audio / wall : 0.0);
+        return true;
+    }
+
+private:
+    /**
+    * Mix the next n samples of all voices
+    *
+    * @param acc - int32 accumulator
+    * @param wave - Q15 buffer of one voice
+    * @param out - saturated samples
+    * @param n
+    */
+    void mix_block(int32_t* acc, int32_t* wave, int16_t* out, long n)
+    {
+        memset(acc, 0, n * sizeof(int32_t));
+        for (Voice& v : Voices)
+        {
+            if (v.Done) continue;
+            if (!render(v, wave, n)) continue;
+            const int32_t ampl = v.Ampl;
+            for (long i = 0; i < n; i++) acc[i] += (wave[i] * ampl) >> 15;
+        }
+        long clipped = 0;
+        for (long i = 0; i < n; i++)
+        {
+            int32_t s = acc[i];
+            clipped += (s > 32767) | (s < -32768);
+            out[i] = (int16_t)(s > 32767 ? 32767 : s < -32768 ? -32768 : s);
+        }
+        Clipped += clipped;
+    }
+
+    /**
+    * Render the next n samples of one voice, key up samples are 0
+    *
+    * @param v
+    * @param wave
+    * @param n
+    * @return bool - false when the voice was silent for the whole block
+    */
+    bool render(Voice& v, int32_t* wave, long n)
+    {
+        const int32_t* quarter = MorseWav::sine_quarter();
+        bool keyed = false;
+        for (long i = 0; i < n;)
+        {
+            if (v.Left == 0 && !next(v))
+            {
+                memset(wave + i, 0, (n - i) * sizeof(int32_t));
+                break;
+            }
+            long run = v.Left < n - i ? v.Left : n - i;
+            if (v.On)
+            {
+                uint32_t phase = v.Phase;
+                for (long k = 0; k < run; k++, phase += v.Step) wave[i + k] = MorseWav::nco_sine(quarter, phase);
+                keyed = true;
+            }
+            else
+            {
+                memset(wave + i, 0, run * sizeof(int32_t));
+            }
+            v.Phase += v.Step * (uint32_t)run;
+            v.Left -= run;
+            i += run;
+        }
+        return keyed;
+    }
+
+    /**
+    * Keying: load the next mark or gap, same timing as MorseWav
+    * (dit 1 on 1 off, dah 3 on 1 off, space 2 off)
+    *
+    * @param v
+    * @return bool - false at the end of the message
+    */
+    bool next(Voice& v)
+    {
+        if (v.Rest > 0)
+        {
+            v.On = false;
+            v.Left = v.Rest * v.Quantum;
+            v.Rest = 0;
+            return true;
+        }
+        while (*v.Code != '\0')
+        {
+            char c = *v.Code++;
+            if (c == '.' || c == '-')
+            {
+                v.On = true;
+                v.Left = (c == '.' ? 1 : 3) * v.Quantum;
+                v.Rest = 1;
+                return true;
+            }
+            if (c == ' ')
+            {
+                v.On = false;
+                v.Left = 2 * v.Quantum;
+                return true;
+            }
+        }
+        v.Done = true;
+        return false;
+    }
+};
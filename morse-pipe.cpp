@@ -0,0 +1,273 @@
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+using namespace std;
+/**
+* C++ MorsePipe Class file used by morse.cpp
+* File to file conversion for the text modus (e b he hb d hd hbd) in three
+* overlapping stages: a reader fills buffers, workers encode or decode them,
+* a writer drains the results in input order.
+*
+* Buffers are cut at line ends, move between the stages through bounded
+* queues and are recycled, so a steady state run allocates nothing.
+* Windows has no io_uring; the reader is a plain thread doing sequential
+* ReadFile calls (FILE_FLAG_SEQUENTIAL_SCAN), which keeps the disk busy while
+* the workers run.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorsePipe
+{
+public:
+    /**
+    * Modus: morse_encode_view 0..3, decoding -1 (morse/binary), -2 (hex), -3 (hex binary)
+    */
+    enum Modus { ENCODE = 0, BINARY = 1, HEXA = 2, HEXABIN = 3, DECODE = -1, HEXADEC = -2, HEXABINDEC = -3 };
+
+    /**
+    * One unit of work, recycled for the whole run
+    */
+    struct Buffer
+    {
+        string in;          // whole lines read
+        size_t size = 0;    // bytes used in in
+        string out;         // converted lines
+        long long seq = 0;  // position in the input
+        bool ok = true;     // conversion succeeded
+    };
+
+    /**
+    * Bounded blocking queue, a fixed ring so it never allocates after construction
+    */
+    class Queue
+    {
+    private:
+        vector<Buffer*> Ring;
+        size_t Head = 0, Size = 0;
+        mutex Lock;
+        condition_variable NotEmpty, NotFull;
+
+    public:
+        Queue(size_t limit) : Ring(limit, NULL) {}
+
+        void push(Buffer* b)
+        {
+            unique_lock<mutex> guard(Lock);
+            NotFull.wait(guard, [this] { return Size < Ring.size(); });
+            Ring[(Head + Size++) % Ring.size()] = b;
+            NotEmpty.notify_one();
+        }
+
+        Buffer* pop()
+        {
+            unique_lock<mutex> guard(Lock);
+            NotEmpty.wait(guard, [this] { return Size > 0; });
+            Buffer* b = Ring[Head];
+            Head = (Head + 1) % Ring.size();
+            Size--;
+            NotFull.notify_one();
+            return b;
+        }
+    };
+
+    /**
+    * Instance variables
+    */
+private:
+#define PIPE_CHUNK (1 << 20)    // bytes read per buffer
+    const Morse& M;
+    int Modus;
+    int Workers;
+    size_t Count;               // buffers in flight
+    vector<Buffer> Pool;
+    Queue Free, Work, Done;
+    atomic<long long> Total;    // buffers read, known at end of input
+    bool Failed = false;
+    DWORD ReadError = 0;        // GetLastError of a failed ReadFile
+
+public:
+    /**
+    * Constructor
+    *
+    * @param morse
+    * @param modus
+    * @param workers
+    */
+    MorsePipe(const Morse& morse, int modus, int workers) : M(morse), Modus(modus), Workers(workers > 0 ? workers : 1),
+        Count(2 * (size_t)Workers + 2), Pool(Count), Free(Count), Work(Count), Done(Count + 1), Total(-1)
+    {
+        for (Buffer& b : Pool)
+        {
+            b.in.resize(PIPE_CHUNK);
+            b.out.reserve(PIPE_CHUNK * 4);
+            Free.push(&b);
+        }
+    }
+
+public:
+    /**
+    * Convert file in to file out (stdout when out is empty)
+    *
+    * @param in
+    * @param out
+    * @return bool
+    */
+    bool run(const string& in, const string& out)
+    {
+        HANDLE src = CreateFileA(in.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (src == INVALID_HANDLE_VALUE)
+        {
+            fprintf(stderr, "Open failed: %s\n", in.c_str());
+            return false;
+        }
+        HANDLE dst = out == "" ? GetStdHandle(STD_OUTPUT_HANDLE) :
+            CreateFileA(out.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (dst == INVALID_HANDLE_VALUE)
+        {
+            fprintf(stderr, "Open failed: %s\n", out.c_str());
+            CloseHandle(src);
+            return false;
+        }
+        vector<thread> workers;
+        for (int i = 0; i < Workers; i++) workers.emplace_back(&MorsePipe::worker, this);
+        thread writer(&MorsePipe::writer, this, dst);
+        reader(src);
+        for (auto& w : workers) w.join();
+        Done.push(NULL); // wake the writer when the last buffer was empty
+        writer.join();
+        CloseHandle(src);
+        if (out != "") CloseHandle(dst);
+        if (ReadError != 0)
+        {
+            fprintf(stderr, "Read failed: %s (error %lu)\n", in.c_str(), (unsigned long)ReadError);
+            return false;
+        }
+        return !Failed;
+    }
+
+private:
+    /**
+    * Stage 1: read whole lines into free buffers
+    *
+    * @param src
+    */
+    void reader(HANDLE src)
+    {
+        string carry = ""; // part of a line at the end of the last read
+        long long seq = 0;
+        bool eof = false;
+        while (!eof)
+        {
+            Buffer* b = Free.pop();
+            b->in.replace(0, carry.size(), carry);
+            b->size = carry.size();
+            carry.clear();
+            // fill up, extending only for lines longer than a buffer
+            while (!eof)
+            {
+                if (b->size == b->in.size()) b->in.resize(b->in.size() * 2);
+                DWORD n = 0;
+                if (!ReadFile(src, &b->in[b->size], (DWORD)(b->in.size() - b->size), &n, NULL))
+                {
+                    ReadError = GetLastError();
+                    eof = true; // convert what was read, run() reports the error
+                }
+                else if (n == 0) eof = true;
+                b->size += n;
+                size_t end = string_view(b->in.data(), b->size).rfind('\n');
+                if (eof || (end != string::npos && b->size == b->in.size()))
+                {
+                    if (!eof)
+                    {
+                        carry.assign(b->in, end + 1, b->size - end - 1);
+                        b->size = end + 1;
+                    }
+                    break;
+                }
+            }
+            b->seq = seq++;
+            Work.push(b);
+        }
+        Total = seq;
+        for (int i = 0; i < Workers; i++) Work.push(NULL);
+    }
+
+private:
+    /**
+    * Stage 2: convert, line by line. Encoding ends a line with '\n' where
+    * the input had one, a last line without it stays without it.
+    */
+    void worker()
+    {
+        Buffer* b;
+        while ((b = Work.pop()) != NULL)
+        {
+            string_view text(b->in.data(), b->size);
+            b->out.clear();
+            b->ok = true;
+            if (Modus < 0)
+            {
+                Morse::decode_state ds;
+                ds.hex = -Modus - 2;
+                b->ok = M.morse_decode_view(text, b->out, ds) && M.morse_decode_end(b->out, ds);
+            }
+            else
+            {
+                size_t start = 0;
+                while (start < text.size())
+                {
+                    size_t end = text.find('\n', start);
+                    if (end == string::npos) end = text.size();
+                    M.morse_encode_view(text.substr(start, end - start), b->out, Modus);
+                    if (end < text.size()) b->out += '\n';
+                    start = end + 1;
+                }
+            }
+            Done.push(b);
+        }
+    }
+
+private:
+    /**
+    * Stage 3: write results in input order and recycle the buffers
+    *
+    * @param dst
+    */
+    void writer(HANDLE dst)
+    {
+        vector<Buffer*> pending(Count, NULL);
+        long long next = 0;
+        while (Total < 0 || next < Total)
+        {
+            Buffer* b = Done.pop();
+            if (b != NULL) pending[b->seq % Count] = b;
+            while ((b = pending[next % Count]) != NULL && b->seq == next)
+            {
+                pending[next % Count] = NULL;
+                DWORD n;
+                if (!b->ok)
+                {
+                    if (!Failed) fprintf(stderr, "INPUT-ERROR in block %lld\n", next);
+                    Failed = true;
+                }
+                else if (!Failed && !b->out.empty() && !WriteFile(dst, b->out.data(), (DWORD)b->out.size(), &n, NULL))
+                {
+                    fprintf(stderr, "Write failed\n");
+                    Failed = true;
+                }
+                Free.push(b);
+                next++;
+            }
+        }
+    }
+};
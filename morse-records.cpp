@@ -0,0 +1,247 @@
+#include <windows.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <chrono>
+
+using namespace std;
+/**
+* C++ MorseRecords Class file used by morse.cpp
+* Record mode for the text modus (e b he hb d hd hbd): millions of short
+* records (callsigns, telemetry lines) converted by one process, one core.
+* Records are framed by newlines, NULs or a u32 little endian length prefix,
+* results are written with the same framing, one result per record; a record
+* that does not decode becomes INPUT-ERROR. A record longer than RECORDS_MAX
+* (or a length prefix above it) stops the run with an error.
+*
+* Input is read in large blocks and converted in place, results are appended
+* to one output buffer by morse_encode_view / morse_decode_view (a length
+* prefix is patched in afterwards), so a record costs no allocation and no
+* copy. The buffer goes out with one WriteFile when full: the gather writes
+* of writev are not needed when the results are already contiguous.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseRecords
+{
+public:
+    /**
+    * Framing of records, -rec:nl, -rec:nul, -rec:len
+    */
+    enum Framing { LINE, NUL, LENGTH };
+
+    /**
+    * Instance variables
+    */
+private:
+#define RECORDS_IN (1 << 20)    // bytes read at a time
+#define RECORDS_OUT (4 << 20)   // bytes written at a time
+#define RECORDS_MAX (16 << 20)  // longest record
+    const Morse& M;
+    int Modus;                  // see MorsePipe::Modus
+    int Frame;
+    string In, Out;             // reused for the whole run
+    long long Records = 0;
+    long long Errors = 0;
+    bool TooLong = false;       // a record longer than RECORDS_MAX, the run stops
+
+public:
+    /**
+    * Constructor
+    *
+    * @param morse
+    * @param modus - MorsePipe::Modus
+    * @param framing
+    */
+    MorseRecords(const Morse& morse, int modus, int framing) : M(morse), Modus(modus), Frame(framing)
+    {
+        In.resize(RECORDS_IN);
+        Out.reserve(RECORDS_OUT + (RECORDS_OUT >> 2));
+    }
+
+public:
+    /**
+    * Get framing by name
+    *
+    * @param name - nl, nul, len
+    * @return int - Framing, -1 when unknown
+    */
+    static int framing(const string& name)
+    {
+        if (name == "nl") return LINE;
+        if (name == "nul") return NUL;
+        if (name == "len") return LENGTH;
+        return -1;
+    }
+
+public:
+    /**
+    * Convert all records of src to dst
+    *
+    * @param src
+    * @param dst
+    * @return bool - false on a write error or records that did not convert
+    */
+    bool run(HANDLE src, HANDLE dst)
+    {
+        auto start = chrono::steady_clock::now();
+        size_t size = 0;
+        bool eof = false;
+        while (!eof)
+        {
+            if (size == In.size()) // a record longer than the buffer, up to the longest with its length prefix
+            {
+                In.resize(In.size() * 2 < RECORDS_MAX + 4 ? In.size() * 2 : RECORDS_MAX + 4);
+            }
+            DWORD n = 0;
+            if (!ReadFile(src, &In[size], (DWORD)(In.size() - size), &n, NULL) || n == 0) eof = true;
+            size += n;
+            size_t used = records(string_view(In.data(), size), eof);
+            if (TooLong)
+            {
+                fprintf(stderr, "Record too long, more than %d bytes, after %lld records\n", RECORDS_MAX, Records);
+                flush(dst);
+                return false;
+            }
+            if (used > 0 && used < size) memmove(&In[0], In.data() + used, size - used);
+            size -= used;
+            if (Out.size() >= RECORDS_OUT && !flush(dst)) return false;
+        }
+        if (size > 0)
+        {
+            fprintf(stderr, "Incomplete record at the end of the input (%zu bytes)\n", size);
+            Errors++;
+        }
+        if (!flush(dst)) return false;
+        if (MorseStats::enabled())
+        {
+            double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            fprintf(stderr, "%lld records, %lld errors in %.3lf s (%.0lf records/s)\n", Records, Errors, s, s > 0 ? Records / s : 0.0);
+        }
+        if (Errors > 0) fprintf(stderr, "INPUT-ERROR in %lld records\n", Errors);
+        return Errors == 0;
+    }
+
+public:
+    /**
+    * Convert records held in memory, all of the input (see rt)
+    *
+    * @param data
+    * @param out - results, framed
+    * @return bool - false on a record longer than RECORDS_MAX, an incomplete
+    *                record or records that did not convert
+    */
+    bool run(string_view data, string& out)
+    {
+        Out.clear();
+        size_t used = records(data, true);
+        out.swap(Out);
+        Out.clear();
+        return !TooLong && used == data.size() && Errors == 0;
+    }
+
+private:
+    /**
+    * Convert the complete records at the start of data
+    *
+    * @param data
+    * @param eof - the last record may have no terminator
+    * @return size_t - bytes used
+    */
+    size_t records(string_view data, bool eof)
+    {
+        size_t pos = 0;
+        while (pos < data.size())
+        {
+            string_view record;
+            size_t next;
+            if (Frame == LENGTH)
+            {
+                uint32_t len;
+                if (data.size() - pos < 4) break;
+                memcpy(&len, data.data() + pos, 4);
+                if (len > RECORDS_MAX)
+                {
+                    TooLong = true;
+                    break;
+                }
+                if (data.size() - pos - 4 < len) break;
+                record = data.substr(pos + 4, len);
+                next = pos + 4 + len;
+            }
+            else
+            {
+                size_t end = data.find(Frame == NUL ? '\0' : '\n', pos);
+                if ((end == string_view::npos ? data.size() : end) - pos > RECORDS_MAX)
+                {
+                    TooLong = true;
+                    break;
+                }
+                if (end == string_view::npos && !eof) break;
+                next = end == string_view::npos ? data.size() : end + 1;
+                record = data.substr(pos, (end == string_view::npos ? data.size() : end) - pos);
+                if (Frame == LINE && !record.empty() && record.back() == '\r') record.remove_suffix(1);
+            }
+            convert(record);
+            pos = next;
+        }
+        return pos;
+    }
+
+    /**
+    * Convert one record and append it, framed, to the output buffer
+    *
+    * @param record
+    */
+    void convert(string_view record)
+    {
+        size_t head = Out.size();
+        if (Frame == LENGTH) Out.append(4, '\0');
+        size_t start = Out.size();
+        if (Modus < 0)
+        {
+            Morse::decode_state ds;
+            ds.hex = -Modus - 2;
+            if (!M.morse_decode_view(record, Out, ds) || !M.morse_decode_end(Out, ds))
+            {
+                Out.resize(start);
+                Out += "INPUT-ERROR";
+                Errors++;
+            }
+        }
+        else
+        {
+            M.morse_encode_view(record, Out, Modus);
+        }
+        if (Frame == LENGTH)
+        {
+            uint32_t len = (uint32_t)(Out.size() - start);
+            memcpy(&Out[head], &len, 4);
+        }
+        else
+        {
+            Out += Frame == NUL ? '\0' : '\n';
+        }
+        Records++;
+    }
+
+    bool flush(HANDLE dst)
+    {
+        for (size_t pos = 0; pos < Out.size();)
+        {
+            DWORD n = 0;
+            if (!WriteFile(dst, Out.data() + pos, (DWORD)(Out.size() - pos), &n, NULL) || n == 0)
+            {
+                fprintf(stderr, "Write failed\n");
+                return false;
+            }
+            pos += n;
+        }
+        Out.clear();
+        return true;
+    }
+};
@@ -0,0 +1,373 @@
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#pragma comment(lib, "Ws2_32.lib")
+
+using namespace std;
+/**
+* C++ MorseServer Class file used by morse.cpp
+* Persistent daemon on a Unix domain socket (AF_UNIX, Windows 10 1803+).
+* One process selects the morse table and builds its codes once,
+* a pool of workers serves encode, decode, hex and WAV requests from it.
+*
+* Wire format, integers and doubles little endian:
+* request: u32 size, then size bytes: u8 op, u8 channels, u16 0, u32 0,
+*          f64 hz, f64 wpm, f64 sps, text (size - 32 bytes)
+* reply:   u32 status (0 ok, 1 error), u32 size, then size bytes:
+*          text, or a complete WAV file for op WAV
+* A connection may send any number of requests. The accept loop polls the
+* idle connections and queues a connection to the workers only when a
+* request arrives; the worker answers that one request and hands the
+* connection back, so idle clients hold no worker. A request must arrive
+* whole within REQUEST_MS, an idle connection is closed after IDLE_MS.
+* WAV replies are streamed (MorseStream) a block at a time, the reply is
+* never held in memory. WAV requests outside the cmd line limits of hz,
+* wpm and sps, or longer than MAX_FRAMES samples, and unknown operations
+* are answered with an error.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseServer
+{
+public:
+    /**
+    * Operations, same order as the cmd line modus e b d he hd hb hbd ew
+    */
+    enum Op { ENCODE, BINARY, DECODE, HEXA, HEXADEC, HEXABIN, HEXABINDEC, WAV, OPS };
+
+    struct Request
+    {
+        uint8_t op = ENCODE;
+        uint8_t channels = 2;
+        double hz = 880.0;
+        double wpm = 16.0;
+        double sps = 44100.0;
+        string text;
+    };
+
+    /**
+    * Instance variables
+    */
+private:
+#define HEAD_SIZE 32                // request header bytes
+#define MAX_REQUEST (64 << 20)      // largest request accepted
+#define MAX_FRAMES (64 << 20)       // longest WAV reply, samples per channel
+#define IDLE_MS 30000               // idle connection closed after
+#define REQUEST_MS 2000             // receive and send timeout within a request
+#define POLL_MS 50                  // accept loop wakes up to take back connections
+    const Morse& M;                 // shared tables, read only in the workers
+    string Path;                    // socket file
+    int Threads;                    // workers
+    SOCKET Listen = INVALID_SOCKET;
+    deque<SOCKET> Queue;            // connections with a request waiting for a worker
+    vector<SOCKET> Done;            // connections answered, back to the accept loop
+    mutex Lock;
+    condition_variable Ready;
+
+public:
+    /**
+    * Constructor
+    *
+    * @param morse
+    * @param path
+    * @param threads
+    */
+    MorseServer(const Morse& morse, const string& path, int threads) : M(morse), Path(path), Threads(threads > 0 ? threads : 1) {}
+
+public:
+    /**
+    * Bind the socket, start the workers, accept connections and queue their
+    * requests until killed
+    *
+    * @return int - exit code
+    */
+    int run()
+    {
+        if (!startup()) return 1;
+        Listen = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = address(Path);
+        DeleteFileA(Path.c_str());
+        if (Listen == INVALID_SOCKET || ::bind(Listen, (sockaddr*)&addr, sizeof addr) != 0 || listen(Listen, SOMAXCONN) != 0)
+        {
+            fprintf(stderr, "Listen failed: %s\n", Path.c_str());
+            if (Listen != INVALID_SOCKET) closesocket(Listen);
+            Listen = INVALID_SOCKET;
+            return 1;
+        }
+        vector<thread> pool;
+        for (int i = 0; i < Threads; i++) pool.emplace_back(&MorseServer::worker, this);
+        printf("listening on %s with %d workers\n", Path.c_str(), Threads);
+        fflush(stdout);
+        vector<SOCKET> idle;                            // connections waiting for a request
+        vector<chrono::steady_clock::time_point> since; // and since when
+        vector<WSAPOLLFD> fds;
+        while (true)
+        {
+            {
+                lock_guard<mutex> guard(Lock);
+                for (SOCKET s : Done)
+                {
+                    idle.push_back(s);
+                    since.push_back(chrono::steady_clock::now());
+                }
+                Done.clear();
+            }
+            fds.assign(idle.size() + 1, WSAPOLLFD());
+            fds[0].fd = Listen;
+            fds[0].events = POLLRDNORM;
+            for (size_t i = 0; i < idle.size(); i++)
+            {
+                fds[i + 1].fd = idle[i];
+                fds[i + 1].events = POLLRDNORM;
+            }
+            if (WSAPoll(fds.data(), (ULONG)fds.size(), POLL_MS) < 0) continue;
+            auto now = chrono::steady_clock::now();
+            size_t kept = 0;
+            for (size_t i = 0; i < idle.size(); i++)
+            {
+                if (fds[i + 1].revents != 0) // a request, or the end of the connection: the worker sees which
+                {
+                    lock_guard<mutex> guard(Lock);
+                    Queue.push_back(idle[i]);
+                    Ready.notify_one();
+                }
+                else if (now - since[i] > chrono::milliseconds(IDLE_MS)) closesocket(idle[i]);
+                else
+                {
+                    idle[kept] = idle[i];
+                    since[kept++] = since[i];
+                }
+            }
+            idle.resize(kept);
+            since.resize(kept);
+            if (fds[0].revents == 0) continue;
+            SOCKET s = accept(Listen, NULL, NULL);
+            if (s == INVALID_SOCKET) continue;
+            DWORD ms = REQUEST_MS;
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&ms, sizeof ms);
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&ms, sizeof ms);
+            idle.push_back(s);
+            since.push_back(now);
+        }
+    }
+
+private:
+    /**
+    * Worker, answers one request at a time, of any connection
+    */
+    void worker()
+    {
+        string body;
+        vector<int16_t> block;
+        while (true)
+        {
+            SOCKET s;
+            {
+                unique_lock<mutex> guard(Lock);
+                Ready.wait(guard, [this] { return !Queue.empty(); });
+                s = Queue.front();
+                Queue.pop_front();
+            }
+            if (!serve(s, body, block))
+            {
+                closesocket(s);
+                continue;
+            }
+            lock_guard<mutex> guard(Lock);
+            Done.push_back(s);
+        }
+    }
+
+private:
+    /**
+    * Answer one request
+    *
+    * @param s
+    * @param body - reused receive buffer
+    * @param block - reused send buffer of WAV replies
+    * @return bool - false when the connection is closed or broken
+    */
+    bool serve(SOCKET s, string& body, vector<int16_t>& block)
+    {
+        Request r;
+        if (!read_request(s, r, body)) return false;
+        if (r.op >= OPS) return reply(s, 1, "UNKNOWN-OP");
+        if (r.op == WAV)
+        {
+            string morse = M.morse_encode(r.text);
+            if (!wav_valid(r, morse)) return reply(s, 1, "INPUT-ERROR");
+            MorseStream ms(morse, r.hz, r.wpm, r.sps, r.channels, M.nco);
+            string header = MorseWav::wav_header(ms.frames(), r.channels, r.sps);
+            uint32_t data_size = (uint32_t)(ms.frames() * r.channels * sizeof(int16_t));
+            uint32_t head[2] = { 0, (uint32_t)header.size() + data_size };
+            if (!write_all(s, (const char*)head, sizeof head) || !write_all(s, header.data(), header.size())) return false;
+            block.resize((size_t)STREAM_BLOCK * r.channels);
+            while (!ms.done())
+            {
+                long n = ms.fill(block.data(), STREAM_BLOCK);
+                if (!write_all(s, (const char*)block.data(), n * r.channels * sizeof(int16_t))) return false;
+            }
+            return true;
+        }
+        string text = "";
+        switch (r.op)
+        {
+        case ENCODE: text = M.morse_encode(r.text); break;
+        case BINARY: text = M.morse_binary(r.text); break;
+        case DECODE: text = M.morse_decode(r.text); break;
+        case HEXA: text = M.bin_morse_hexadecimal(r.text, 0); break;
+        case HEXADEC: text = M.hexadecimal_bin_txt(r.text, 0); break;
+        case HEXABIN: text = M.bin_morse_hexadecimal(r.text, 1); break;
+        case HEXABINDEC: text = M.hexadecimal_bin_txt(r.text, 1); break;
+        }
+        return reply(s, text == "INPUT-ERROR" ? 1 : 0, text);
+    }
+
+private:
+    /**
+    * Check the settings of a WAV request against the cmd line limits
+    * and its length before anything is allocated
+    *
+    * @param r
+    * @param morse - encoded text
+    * @return bool
+    */
+    bool wav_valid(const Request& r, const string& morse) const
+    {
+        if (!isfinite(r.hz) || !isfinite(r.wpm) || !isfinite(r.sps) || (r.channels != 1 && r.channels != 2)) return false;
+        if (r.hz < M.min_frequency_in_hertz || r.hz > M.max_frequency_in_hertz) return false;
+        if (r.wpm < M.min_words_per_minute || r.wpm > M.max_words_per_minute) return false;
+        if (r.sps < M.min_samples_per_second || r.sps > M.max_samples_per_second) return false;
+        double quanta = 0; // as MorseWav: dit 2, dah 4, space 2
+        for (char c : morse) quanta += c == '-' ? 4 : c == '.' || c == ' ' ? 2 : 0;
+        return quanta * floor(1.2 / r.wpm * r.sps) <= MAX_FRAMES;
+    }
+
+private:
+    /**
+    * Read and parse one request
+    *
+    * @param s
+    * @param r
+    * @param body - reused receive buffer
+    * @return bool - false on end of connection or a malformed request
+    */
+    bool read_request(SOCKET s, Request& r, string& body)
+    {
+        uint32_t size;
+        if (!read_all(s, (char*)&size, sizeof size) || size < HEAD_SIZE || size > MAX_REQUEST) return false;
+        body.resize(size);
+        if (!read_all(s, &body[0], size)) return false;
+        r.op = (uint8_t)body[0];
+        r.channels = (uint8_t)body[1];
+        memcpy(&r.hz, &body[8], 8);
+        memcpy(&r.wpm, &body[16], 8);
+        memcpy(&r.sps, &body[24], 8);
+        r.text.assign(body, HEAD_SIZE, string::npos);
+        return true;
+    }
+
+    bool reply(SOCKET s, uint32_t status, const string& text)
+    {
+        uint32_t head[2] = { status, (uint32_t)text.size() };
+        return write_all(s, (const char*)head, sizeof head) && write_all(s, text.data(), text.size());
+    }
+
+public:
+    /**
+    * Client: send one request to a running server and wait for the reply
+    *
+    * @param path
+    * @param r
+    * @param out - text or WAV file bytes
+    * @return int - status, 0 ok, 1 error, -1 no connection
+    */
+    static int call(const string& path, const Request& r, string& out)
+    {
+        if (!startup()) return -1;
+        SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr = address(path);
+        if (s == INVALID_SOCKET || connect(s, (sockaddr*)&addr, sizeof addr) != 0)
+        {
+            if (s != INVALID_SOCKET) closesocket(s);
+            return -1;
+        }
+        string body(HEAD_SIZE, '\0');
+        body[0] = (char)r.op;
+        body[1] = (char)r.channels;
+        memcpy(&body[8], &r.hz, 8);
+        memcpy(&body[16], &r.wpm, 8);
+        memcpy(&body[24], &r.sps, 8);
+        body += r.text;
+        uint32_t size = (uint32_t)body.size();
+        uint32_t head[2];
+        int status = -1;
+        if (write_all(s, (const char*)&size, sizeof size) && write_all(s, body.data(), body.size()) &&
+            read_all(s, (char*)head, sizeof head))
+        {
+            out.resize(head[1]);
+            if (head[1] == 0 || read_all(s, &out[0], head[1])) status = (int)head[0];
+        }
+        closesocket(s);
+        return status;
+    }
+
+private:
+    static bool startup()
+    {
+        static int ok = -1;
+        static mutex once;
+        lock_guard<mutex> guard(once);
+        if (ok < 0)
+        {
+            WSADATA wsa;
+            ok = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+        }
+        return ok == 1;
+    }
+
+    static sockaddr_un address(const string& path)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        strncpy_s(addr.sun_path, sizeof addr.sun_path, path.c_str(), _TRUNCATE);
+        return addr;
+    }
+
+    static bool read_all(SOCKET s, char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            int n = recv(s, data, size > (1 << 30) ? (1 << 30) : (int)size, 0);
+            if (n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static bool write_all(SOCKET s, const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            int n = send(s, data, size > (1 << 30) ? (1 << 30) : (int)size, 0);
+            if (n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+};
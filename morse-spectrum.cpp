@@ -0,0 +1,271 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+/**
+* C++ MorseSpectrum Class file used by morse.cpp
+* Short-time FFT of PCM (rendered morse or a WAV file) to a waterfall
+* image (PGM, time down, frequency left to right) and a CSV with the
+* peak frequency and the energy of every frame.
+*
+* The real FFT of size N runs as a complex radix-2 FFT of size N/2 plus
+* a split step. Twiddles, bit reversal and the Hann window are computed
+* once per size, frame buffers are reused, so a frame costs no allocation.
+* Long captures are pooled (mean power) to at most SPECTRUM_ROWS image rows.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseSpectrum
+{
+    /**
+    * Instance variables
+    */
+private:
+#define SPECTRUM_ROWS 2048  // image rows at most
+#define SPECTRUM_RANGE 80.0 // dB shown below the strongest pixel
+    int N;                  // fft size, power of 2
+    int M;                  // N / 2, size of the complex fft
+    int Hop;                // samples between frames
+    vector<float> Window;   // Hann window, N
+    vector<float> TwR, TwI; // e^(-2 pi i k / N), k < N / 2
+    vector<int> Rev;        // bit reversal of M
+    vector<float> Re, Im;   // complex fft buffer, M
+    vector<float> Power;    // |X(k)|^2 of one frame, k < N / 2
+
+public:
+    /**
+    * Constructor
+    *
+    * @param size - fft size, rounded down to a power of 2 (64 .. 65536)
+    * @param hop - samples between frames, 0 for size / 2
+    */
+    MorseSpectrum(int size, int hop)
+    {
+        N = 64;
+        while (N * 2 <= size && N < 65536) N *= 2;
+        M = N / 2;
+        Hop = hop > 0 ? hop : M;
+        Window.resize(N);
+        for (int n = 0; n < N; n++) Window[n] = (float)(0.5 - 0.5 * cos(2.0 * 3.141592653589793 * n / N));
+        TwR.resize(M);
+        TwI.resize(M);
+        for (int k = 0; k < M; k++)
+        {
+            TwR[k] = (float)cos(2.0 * 3.141592653589793 * k / N);
+            TwI[k] = (float)-sin(2.0 * 3.141592653589793 * k / N);
+        }
+        Rev.resize(M);
+        int bits = 0;
+        while ((1 << bits) < M) bits++;
+        for (int i = 0; i < M; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+            Rev[i] = r;
+        }
+        Re.resize(M);
+        Im.resize(M);
+        Power.resize(M);
+    }
+
+public:
+    /**
+    * Spectrogram of a WAV file (PCM 16 bit, first channel), memory mapped
+    *
+    * @param path
+    * @param base - output file name without extension
+    * @return bool
+    */
+    bool run_file(const string& path, const string& base)
+    {
+        MorseFile in(path.c_str());
+        string_view wav = in.view();
+        if (!in.ok())
+        {
+            fprintf(stderr, "Open failed: %s\n", path.c_str());
+            return false;
+        }
+        const int16_t* pcm;
+        long frames;
+        int channels;
+        double sps;
+        if (!MorseWav::wav_pcm(wav, pcm, frames, channels, sps))
+        {
+            fprintf(stderr, "Only 16 bit PCM WAV files are supported: %s\n", path.c_str());
+            return false;
+        }
+        return run(pcm, frames, channels, sps, base);
+    }
+
+public:
+    /**
+    * Spectrogram of interleaved PCM, first channel
+    *
+    * @param pcm
+    * @param frames
+    * @param channels
+    * @param sps
+    * @param base - output file name without extension
+    * @return bool - false when the audio is shorter than one frame or on write errors
+    */
+    bool run(const int16_t* pcm, long frames, int channels, double sps, const string& base)
+    {
+        if (frames < N)
+        {
+            fprintf(stderr, "Audio too short: %ld samples, -fft:%d needs at least %d\n", frames, N, N);
+            return false;
+        }
+        auto start = chrono::steady_clock::now();
+        long count = (frames - N) / Hop + 1;
+        long pool = (count + SPECTRUM_ROWS - 1) / SPECTRUM_ROWS;
+        if (pool < 1) pool = 1;
+        long rows = (count + pool - 1) / pool;
+        vector<float> image((size_t)rows * M, 0.0f);
+        string csv_path = base + ".csv", pgm_path = base + ".pgm";
+        FILE* csv;
+#pragma warning(suppress : 4996)
+        if ((csv = fopen(csv_path.c_str(), "wb")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", csv_path.c_str());
+            return false;
+        }
+        fprintf(csv, "frame,seconds,peak_hz,peak_db,energy_db\n");
+        for (long f = 0; f < count; f++)
+        {
+            frame(pcm + (size_t)f * Hop * channels, channels);
+            double energy = 0.0;
+            int peak = 1;
+            for (int k = 0; k < M; k++)
+            {
+                energy += Power[k];
+                if (k > 0 && Power[k] > Power[peak]) peak = k;
+            }
+            float* row = &image[(size_t)(f / pool) * M];
+            for (int k = 0; k < M; k++) row[k] += Power[k] / pool;
+            fprintf(csv, "%ld,%.4lf,%.2lf,%.2lf,%.2lf\n", f, (double)f * Hop / sps, peak_hz(peak, sps), db(Power[peak]), db(energy));
+        }
+        bool ok = !ferror(csv);
+        if (fclose(csv) != 0) ok = false;
+        if (!ok)
+        {
+            fprintf(stderr, "Write failed: %s\n", csv_path.c_str());
+            return false;
+        }
+        if (!write_pgm(pgm_path, image, rows)) return false;
+        double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%ld frames of %d samples (hop %d, %.1lf Hz per bin) from %.1lf s of audio in %.3lf s\n",
+            count, N, Hop, sps / N, frames / sps, wall);
+        printf("written to %s (%d x %ld) and %s\n", pgm_path.c_str(), M, rows, csv_path.c_str());
+        return true;
+    }
+
+private:
+    /**
+    * Window one frame and get its power spectrum in Power
+    *
+    * @param pcm
+    * @param channels
+    */
+    void frame(const int16_t* pcm, int channels)
+    {
+        // even samples real, odd samples imaginary, in bit reversed order
+        for (int n = 0; n < M; n++)
+        {
+            int r = Rev[n];
+            Re[r] = pcm[(2 * n) * channels] * Window[2 * n];
+            Im[r] = pcm[(2 * n + 1) * channels] * Window[2 * n + 1];
+        }
+        for (int size = 2; size <= M; size *= 2)
+        {
+            int half = size / 2, step = 2 * (M / size); // step in the N / 2 twiddle table
+            for (int start = 0; start < M; start += size)
+            {
+                for (int j = 0; j < half; j++)
+                {
+                    float wr = TwR[j * step], wi = TwI[j * step];
+                    int a = start + j, b = a + half;
+                    float vr = Re[b] * wr - Im[b] * wi;
+                    float vi = Re[b] * wi + Im[b] * wr;
+                    Re[b] = Re[a] - vr;
+                    Im[b] = Im[a] - vi;
+                    Re[a] += vr;
+                    Im[a] += vi;
+                }
+            }
+        }
+        // split: X(k) = E(k) + W^k O(k), E and O from Z(k) and conj Z(M - k)
+        for (int k = 0; k < M; k++)
+        {
+            int j = k == 0 ? 0 : M - k;
+            float a = Re[k], b = Im[k], c = Re[j], d = Im[j];
+            float er = 0.5f * (a + c), ei = 0.5f * (b - d);
+            float orr = 0.5f * (b + d), oi = -0.5f * (a - c);
+            float xr = er + TwR[k] * orr - TwI[k] * oi;
+            float xi = ei + TwR[k] * oi + TwI[k] * orr;
+            Power[k] = xr * xr + xi * xi;
+        }
+    }
+
+private:
+    /**
+    * Peak frequency, parabolic interpolation over the log power of the neighbours
+    */
+    double peak_hz(int k, double sps)
+    {
+        double delta = 0.0;
+        if (k > 0 && k < M - 1)
+        {
+            double a = db(Power[k - 1]), b = db(Power[k]), c = db(Power[k + 1]);
+            double d = a - 2.0 * b + c;
+            if (d < 0.0) delta = 0.5 * (a - c) / d;
+        }
+        return (k + delta) * sps / N;
+    }
+
+    static double db(double power)
+    {
+        return 10.0 * log10(power + 1e-12);
+    }
+
+private:
+    /**
+    * Write the waterfall, SPECTRUM_RANGE dB below the strongest pixel is black
+    *
+    * @param path
+    * @param image
+    * @param rows
+    * @return bool
+    */
+    bool write_pgm(const string& path, const vector<float>& image, long rows)
+    {
+        double top = -1e9;
+        for (float p : image) if (db(p) > top) top = db(p);
+        vector<unsigned char> pixels(image.size());
+        for (size_t i = 0; i < image.size(); i++)
+        {
+            double v = (db(image[i]) - (top - SPECTRUM_RANGE)) * 255.0 / SPECTRUM_RANGE;
+            pixels[i] = (unsigned char)(v < 0.0 ? 0.0 : v > 255.0 ? 255.0 : v);
+        }
+        FILE* file;
+#pragma warning(suppress : 4996)
+        if ((file = fopen(path.c_str(), "wb")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", path.c_str());
+            return false;
+        }
+        fprintf(file, "P5\n%d %ld\n255\n", M, rows);
+        bool ok = pixels.empty() || fwrite(pixels.data(), pixels.size(), 1, file) == 1;
+        if (ferror(file)) ok = false;
+        if (fclose(file) != 0) ok = false;
+        if (!ok) fprintf(stderr, "Write failed: %s\n", path.c_str());
+        return ok;
+    }
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+/**
+* C++ MorseStats Class file used by morse.cpp and morse-wav.cpp
+* Per-stage timers and counters for the hot paths: wall time, calls,
+* bytes in and out and heap allocations.
+*
+* Every thread writes its own block of counters (single writer, relaxed
+* atomics, no locks); blocks are pushed once on a lock-free list so a
+* snapshot can add up all threads. With stats disabled a scope costs
+* one relaxed load.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseStats
+{
+public:
+    /**
+    * Stages
+    */
+    enum Stage { FIX_INPUT, LOOKUP, EXPAND, DECODE, SYNTH, WAV_WRITE, STAGES };
+
+    struct Counter
+    {
+        uint64_t calls = 0, nanos = 0, bytes_in = 0, bytes_out = 0, allocs = 0;
+    };
+
+    struct Totals
+    {
+        Counter stage[STAGES];
+    };
+
+private:
+    struct Block
+    {
+        atomic<uint64_t> calls[STAGES], nanos[STAGES], bytes_in[STAGES], bytes_out[STAGES], allocs[STAGES];
+        Block* next = NULL;
+        Block()
+        {
+            for (int i = 0; i < STAGES; i++)
+            {
+                calls[i] = 0; nanos[i] = 0; bytes_in[i] = 0; bytes_out[i] = 0; allocs[i] = 0;
+            }
+        }
+    };
+
+    static atomic<bool>& enabled_flag() { static atomic<bool> flag(false); return flag; }
+    static atomic<Block*>& head() { static atomic<Block*> list(NULL); return list; }
+    static bool& json_flag() { static bool json = false; return json; }
+
+    /**
+    * Get the counters of the calling thread, registered on first use.
+    * Blocks are never freed, totals of finished threads stay counted.
+    *
+    * @return Block&
+    */
+    static Block& block()
+    {
+        static thread_local Block* mine = NULL;
+        if (mine == NULL)
+        {
+            mine = new Block();
+            Block* first = head().load(memory_order_relaxed);
+            do { mine->next = first; } while (!head().compare_exchange_weak(first, mine, memory_order_release, memory_order_relaxed));
+        }
+        return *mine;
+    }
+
+    static void add(atomic<uint64_t>& a, uint64_t v) { a.store(a.load(memory_order_relaxed) + v, memory_order_relaxed); }
+
+public:
+    /**
+    * Switch recording on or off (library API)
+    *
+    * @param on
+    */
+    static void enable(bool on) { enabled_flag().store(on, memory_order_relaxed); }
+
+    static bool enabled() { return enabled_flag().load(memory_order_relaxed); }
+
+    /**
+    * Heap allocations of the calling thread, counted by operator new in morse.cpp
+    * and by the PCM buffer allocators.
+    *
+    * @return uint64_t&
+    */
+    static uint64_t& allocations() { static thread_local uint64_t n = 0; return n; }
+
+    static void count_alloc() { allocations()++; }
+
+    /**
+    * Record one call of a stage
+    *
+    * @param stage
+    * @param nanos
+    * @param in
+    * @param out
+    * @param allocs
+    */
+    static void record(int stage, uint64_t nanos, uint64_t in, uint64_t out, uint64_t allocs)
+    {
+        Block& b = block();
+        add(b.calls[stage], 1);
+        add(b.nanos[stage], nanos);
+        add(b.bytes_in[stage], in);
+        add(b.bytes_out[stage], out);
+        add(b.allocs[stage], allocs);
+    }
+
+    /**
+    * Add up the counters of all threads (library API)
+    *
+    * @return Totals
+    */
+    static Totals snapshot()
+    {
+        Totals t;
+        for (Block* b = head().load(memory_order_acquire); b != NULL; b = b->next)
+        {
+            for (int i = 0; i < STAGES; i++)
+            {
+                t.stage[i].calls += b->calls[i].load(memory_order_relaxed);
+                t.stage[i].nanos += b->nanos[i].load(memory_order_relaxed);
+                t.stage[i].bytes_in += b->bytes_in[i].load(memory_order_relaxed);
+                t.stage[i].bytes_out += b->bytes_out[i].load(memory_order_relaxed);
+                t.stage[i].allocs += b->allocs[i].load(memory_order_relaxed);
+            }
+        }
+        return t;
+    }
+
+    static const char* stage_name(int stage)
+    {
+        const char* names[] = { "fix_input", "lookup", "expand", "decode", "synth", "wav_write" };
+        return names[stage];
+    }
+
+    /**
+    * Print totals as a table or as one line of JSON
+    *
+    * @param out
+    * @param json
+    */
+    static void print(FILE* out, bool json)
+    {
+        Totals t = snapshot();
+        if (json)
+        {
+            fprintf(out, "{\"stages\":{");
+            for (int i = 0; i < STAGES; i++)
+            {
+                const Counter& c = t.stage[i];
+                fprintf(out, "%s\"%s\":{\"calls\":%llu,\"ns\":%llu,\"bytes_in\":%llu,\"bytes_out\":%llu,\"allocs\":%llu}",
+                    i ? "," : "", stage_name(i), (unsigned long long)c.calls, (unsigned long long)c.nanos,
+                    (unsigned long long)c.bytes_in, (unsigned long long)c.bytes_out, (unsigned long long)c.allocs);
+            }
+            fprintf(out, "}}\n");
+            return;
+        }
+        fprintf(out, "%-10s %10s %12s %12s %12s %10s\n", "stage", "calls", "ms", "bytes in", "bytes out", "allocs");
+        for (int i = 0; i < STAGES; i++)
+        {
+            const Counter& c = t.stage[i];
+            fprintf(out, "%-10s %10llu %12.3lf %12llu %12llu %10llu\n", stage_name(i), (unsigned long long)c.calls,
+                c.nanos / 1e6, (unsigned long long)c.bytes_in, (unsigned long long)c.bytes_out, (unsigned long long)c.allocs);
+        }
+    }
+
+    /**
+    * Print to stderr when the program ends (-stats / -stats:json)
+    *
+    * @param json
+    */
+    static void print_at_exit(bool json)
+    {
+        json_flag() = json;
+        atexit([] { print(stderr, json_flag()); });
+    }
+
+public:
+    /**
+    * Times one call of a stage from construction to destruction,
+    * set out before the scope ends.
+    */
+    class Scope
+    {
+    private:
+        int Stage;
+        bool On;
+        uint64_t In;
+        uint64_t Allocs = 0;
+        chrono::steady_clock::time_point Start;
+
+    public:
+        uint64_t out = 0;
+
+        Scope(int stage, uint64_t in) : Stage(stage), On(enabled()), In(in)
+        {
+            if (On)
+            {
+                Allocs = allocations();
+                Start = chrono::steady_clock::now();
+            }
+        }
+
+        ~Scope()
+        {
+            if (On)
+            {
+                uint64_t ns = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - Start).count();
+                record(Stage, ns, In, out, allocations() - Allocs);
+            }
+        }
+    };
+};
@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+/**
+* C++ MorseStream Class file used by morse.cpp
+* Pull-based lazy rendering of morse text: an audio callback or a transmit
+* loop asks for a block of samples at a time, fill() walks the text and the
+* element timing from where the last call stopped. The samples are those
+* of MorseWav (same tone, wpm, sps, channels and synthesis), in any block
+* sizes; sending can start after the first block.
+*
+* With the phase reset at every quantum all key down quanta are the same
+* samples: the constructor renders one (the only allocation), fill() copies
+* from it or writes silence. fill() never allocates, has no locks and costs
+* O(frames), for real-time threads. The text is not copied, it must outlive
+* the stream. The radio channel works on whole buffers, it is not applied.
+*
+* State: text position, quanta left of the current character (bit pattern,
+* key down first bit), current quantum on or off and samples of it done.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+class MorseStream
+{
+    /**
+    * Instance variables
+    */
+private:
+#define STREAM_BLOCK 65536  // frames per write of save()
+    string_view Text;       // morse text, not owned
+    const int Channels;
+    const double Sps;
+    const long N;           // samples per quantum, as MorseWav
+    vector<int16_t> Mark;   // one key down quantum, interleaved
+    long Frames = 0;        // frames of the whole text
+    size_t Pos = 0;         // next character
+    uint32_t Pattern = 0;   // quanta left of the character, bit 0 first, 1 = key down
+    int Left = 0;           // number of them
+    bool On = false;        // current quantum
+    long Offset = 0;        // samples of the current quantum done
+    long Played = 0;        // frames filled from the text
+
+public:
+    /**
+    * Constructor
+    *
+    * @param morsecode - dots, dashes and spaces, kept by reference
+    * @param tone
+    * @param wpm
+    * @param samples_per_second
+    * @param modus - channels, 1 or 2
+    * @param nco - fixed-point synthesis
+    */
+    MorseStream(string_view morsecode, double tone, double wpm, double samples_per_second, int modus, bool nco = false)
+        : Text(morsecode), Channels(modus), Sps(samples_per_second), N((long)(1.2 / wpm * samples_per_second))
+    {
+        long quanta = 0;
+        for (char c : Text)
+        {
+            int left;
+            pattern(c, left);
+            quanta += left;
+        }
+        Frames = N > 0 ? quanta * N : 0;
+        Mark.resize(N > 0 ? (size_t)N * Channels : 0);
+        MorseWav::quantum(Mark.data(), N > 0 ? N : 0, Channels, 1, tone, Sps, nco, MorseWav::nco_step(tone, Sps));
+        rewind();
+    }
+
+public:
+    /**
+    * Fill a block, exactly frames samples per channel, silence after the end
+    *
+    * @param out - interleaved, frames * channels
+    * @param frames
+    * @return long - frames of the text in the block, less than frames at the end
+    */
+    long fill(int16_t* out, long frames)
+    {
+        long done = 0;
+        while (done < frames)
+        {
+            if (Offset == N && !next_quantum()) break;
+            long k = N - Offset < frames - done ? N - Offset : frames - done;
+            if (On) memcpy(out + done * Channels, Mark.data() + Offset * Channels, k * Channels * sizeof(int16_t));
+            else memset(out + done * Channels, 0, k * Channels * sizeof(int16_t));
+            Offset += k;
+            done += k;
+        }
+        if (done < frames) memset(out + done * Channels, 0, (frames - done) * Channels * sizeof(int16_t));
+        Played += done;
+        return done;
+    }
+
+    /**
+    * Start again from the beginning of the text (beacons loop)
+    */
+    void rewind()
+    {
+        Pos = 0;
+        Pattern = 0;
+        Left = 0;
+        On = false;
+        Offset = N;
+        Played = 0;
+    }
+
+    /**
+    * Get the number of frames of the whole text, known before rendering
+    *
+    * @return long
+    */
+    long frames() const { return Frames; }
+
+    /**
+    * Get the number of frames filled from the text so far
+    *
+    * @return long
+    */
+    long position() const { return Played; }
+
+    /**
+    * Check for the end of the text
+    *
+    * @return bool
+    */
+    bool done() const { return Played >= Frames; }
+
+public:
+    /**
+    * Write a WAV file, a block at a time: memory of one block whatever the
+    * length of the text
+    *
+    * @param path
+    * @return long - bytes written, -1 on failure
+    */
+    long save(const char* path)
+    {
+        MorseStats::Scope scope(MorseStats::WAV_WRITE, Frames * Channels * sizeof(int16_t));
+        string header = MorseWav::wav_header(Frames, Channels, Sps);
+        FILE* file;
+#pragma warning(suppress : 4996)
+        if ((file = fopen(path, "wb")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", path);
+            return -1;
+        }
+        rewind();
+        vector<int16_t> block((size_t)STREAM_BLOCK * Channels);
+        bool ok = fwrite(header.data(), header.size(), 1, file) == 1;
+        while (ok && !done())
+        {
+            long n = fill(block.data(), STREAM_BLOCK);
+            ok = fwrite(block.data(), n * Channels * sizeof(int16_t), 1, file) == 1;
+        }
+        if (fclose(file) != 0) ok = false;
+        if (!ok)
+        {
+            fprintf(stderr, "Write failed: %s\n", path);
+            return -1;
+        }
+        long size = (long)header.size() + Frames * Channels * (long)sizeof(int16_t);
+        scope.out = size;
+        return size;
+    }
+
+private:
+    /**
+    * Quanta of a character: dit 1 on 1 off, dah 3 on 1 off, space 2 off,
+    * anything else nothing (as MorseWav)
+    *
+    * @param c
+    * @param left - number of quanta
+    * @return uint32_t - bit 0 first, 1 = key down
+    */
+    static uint32_t pattern(char c, int& left)
+    {
+        if (c == '.') { left = 2; return 0x1; }
+        if (c == '-') { left = 4; return 0x7; }
+        if (c == ' ') { left = 2; return 0x0; }
+        left = 0;
+        return 0;
+    }
+
+    bool next_quantum()
+    {
+        while (Left == 0)
+        {
+            if (Pos >= Text.size() || N <= 0) return false;
+            Pattern = pattern(Text[Pos++], Left);
+        }
+        On = Pattern & 1;
+        Pattern >>= 1;
+        Left--;
+        Offset = 0;
+        return true;
+    }
+};
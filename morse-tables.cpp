@@ -0,0 +1,316 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <array>
+
+using namespace std;
+/**
+* C++ MorseTable Class file used by morse.cpp
+* Selectable morse code tables, compiled into lookup arrays at compile time:
+*
+* encode:  code point -> symbol, direct index over U+0000..U+07FF
+*          (ASCII, Latin-1, Greek, Cyrillic), lower case folded to upper case
+* prosign: "<SK>" style names -> symbol, perfect hash with a precomputed seed
+* decode:  code (leading 1 marker, 0 dit, 1 dah) -> symbol, direct index
+*
+* Every lookup is O(1) and allocation free. Input is UTF-8.
+*
+* Tables: itu (the table of this program), cyrillic (Russian letters with
+* the itu digits and punctuation). Both carry the prosigns.
+* Three prosigns are aliases, their codes come first in the table as other
+* symbols and the first symbol of a code wins the decode slot: <HH> (error)
+* decodes as ERR, <BT> as = and <KN> as (. Every other prosign decodes to
+* itself (checked by rt).
+* American Morse is not here: its spaced letters and long dashes have no
+* form in the dit/dah codes the encoder, decoder and MorseWav share.
+*
+* @author Ray Colt <ray_colt@pentagon.mil>
+* @copyright Copyright (c) 1978, 2021 Ray Colt
+* @license Public General License US Army, Microsoft Corporation (MIT)
+**/
+struct MorseSymbol
+{
+    uint32_t cp;        // code point, 0 for named symbols
+    const char* name;   // prosign or other multi character symbol, NULL for code points
+    const char* code;   // dit/dah code
+};
+
+/**
+* Symbol lists
+*/
+constexpr MorseSymbol morse_latin_letters[] = {
+    { 'A', NULL, ".-" }, { 'B', NULL, "-..." }, { 'C', NULL, "-.-." }, { 'D', NULL, "-.." },
+    { 'E', NULL, "." }, { 'F', NULL, "..-." }, { 'G', NULL, "--." }, { 'H', NULL, "...." },
+    { 'I', NULL, ".." }, { 'J', NULL, ".---" }, { 'K', NULL, "-.-" }, { 'L', NULL, ".-.." },
+    { 'M', NULL, "--" }, { 'N', NULL, "-." }, { 'O', NULL, "---" }, { 'P', NULL, ".--." },
+    { 'Q', NULL, "--.-" }, { 'R', NULL, ".-." }, { 'S', NULL, "..." }, { 'T', NULL, "-" },
+    { 'U', NULL, "..-" }, { 'V', NULL, "...-" }, { 'W', NULL, ".--" }, { 'X', NULL, "-..-" },
+    { 'Y', NULL, "-.--" }, { 'Z', NULL, "--.." },
+};
+
+constexpr MorseSymbol morse_cyrillic_letters[] = {
+    { 0x410, NULL, ".-" }, { 0x411, NULL, "-..." }, { 0x412, NULL, ".--" }, { 0x413, NULL, "--." },      // A B V G
+    { 0x414, NULL, "-.." }, { 0x415, NULL, "." }, { 0x416, NULL, "...-" }, { 0x417, NULL, "--.." },      // D E ZH Z
+    { 0x418, NULL, ".." }, { 0x419, NULL, ".---" }, { 0x41A, NULL, "-.-" }, { 0x41B, NULL, ".-.." },     // I J K L
+    { 0x41C, NULL, "--" }, { 0x41D, NULL, "-." }, { 0x41E, NULL, "---" }, { 0x41F, NULL, ".--." },       // M N O P
+    { 0x420, NULL, ".-." }, { 0x421, NULL, "..." }, { 0x422, NULL, "-" }, { 0x423, NULL, "..-" },        // R S T U
+    { 0x424, NULL, "..-." }, { 0x425, NULL, "...." }, { 0x426, NULL, "-.-." }, { 0x427, NULL, "---." },  // F H C CH
+    { 0x428, NULL, "----" }, { 0x429, NULL, "--.-" }, { 0x42A, NULL, "--.--" }, { 0x42B, NULL, "-.--" }, // SH SHCH hard Y
+    { 0x42C, NULL, "-..-" }, { 0x42D, NULL, "..-.." }, { 0x42E, NULL, "..--" }, { 0x42F, NULL, ".-.-" }, // soft E YU YA
+    { 0x401, NULL, "." },                                                                                // YO (as E)
+};
+
+constexpr MorseSymbol morse_common_symbols[] = {
+    { '0', NULL, "-----" }, { '1', NULL, ".----" }, { '2', NULL, "..---" }, { '3', NULL, "...--" },
+    { '4', NULL, "....-" }, { '5', NULL, "....." }, { '6', NULL, "-...." }, { '7', NULL, "--..." },
+    { '8', NULL, "---.." }, { '9', NULL, "----." },
+    { '!', NULL, "-.-.--" }, { '$', NULL, "...-..-" }, { '"', NULL, ".-..-." }, { '\'', NULL, ".----." },
+    { '(', NULL, "-.--." }, { ')', NULL, "-.--.-" }, { ',', NULL, "--..--" }, { '-', NULL, "-....-" },
+    { '.', NULL, ".-.-.-" }, { '/', NULL, "-..-." }, { ':', NULL, "---..." }, { ';', NULL, "-.-.-." },
+    { '=', NULL, "-...-" }, { '?', NULL, "..--.." }, { '@', NULL, ".--.-." }, { '_', NULL, "..--.-" },
+    { 0, "ERR", "........" },
+};
+
+constexpr MorseSymbol morse_prosigns[] = {
+    { 0, "<AR>", ".-.-." }, { 0, "<AS>", ".-..." }, { 0, "<BK>", "-...-.-" }, { 0, "<BT>", "-...-" },   // <BT> decodes as =
+    { 0, "<CL>", "-.-..-.." }, { 0, "<CT>", "-.-.-" }, { 0, "<HH>", "........" }, { 0, "<KN>", "-.--." },  // <HH> as ERR, <KN> as (
+    { 0, "<SK>", "...-.-" }, { 0, "<SN>", "...-." }, { 0, "<SOS>", "...---..." },
+};
+
+class MorseTable
+{
+public:
+    enum
+    {
+        MAX_SYMBOLS = 256,      // symbols per table
+        MAX_ELEMENTS = 9,       // dits and dahs per code
+        CODES = 1 << (MAX_ELEMENTS + 1),
+        CODE_POINTS = 0x800,    // direct index range
+        HASH = 64,              // prosign hash slots
+        SEED = 4,               // prosign hash seed, found by hash_prosigns()
+        SEED_TRIES = 64,        // seeds tried from SEED, in the constexpr step limits of the compilers (MSVC /constexpr:steps)
+        NONE = -1,              // not in the table
+        SPACE = -2              // whitespace
+    };
+
+    const char* name = "";
+    int count = 0;
+    uint32_t seed = 0;                      // perfect hash seed for the prosigns
+    uint16_t encode[CODE_POINTS] = {};      // code point -> symbol + 1
+    uint16_t prosign[HASH] = {};            // hash of name -> symbol + 1
+    uint16_t decode[CODES] = {};            // code -> symbol + 1
+    uint16_t codes[MAX_SYMBOLS] = {};       // symbol -> code
+    char text[MAX_SYMBOLS][12] = {};        // symbol -> UTF-8 text
+
+public:
+    /**
+    * Build a table from symbol lists, at compile time.
+    * The first symbol of a code wins the decode slot.
+    *
+    * @param table_name
+    * @param a, b, c - symbol lists
+    * @return MorseTable
+    */
+    template<size_t A, size_t B, size_t C>
+    static constexpr MorseTable make(const char* table_name, const MorseSymbol(&a)[A], const MorseSymbol(&b)[B], const MorseSymbol(&c)[C])
+    {
+        static_assert(A + B + C <= MAX_SYMBOLS, "too many symbols");
+        MorseTable t;
+        t.name = table_name;
+        for (size_t i = 0; i < A + B + C; i++)
+        {
+            const MorseSymbol& s = i < A ? a[i] : i < A + B ? b[i - A] : c[i - A - B];
+            t.add(s);
+        }
+        t.hash_prosigns(a, b, c);
+        return t;
+    }
+
+private:
+    constexpr void add(const MorseSymbol& s)
+    {
+        int sym = count++;
+        uint16_t code = 1;
+        for (const char* p = s.code; *p != '\0'; p++) code = (uint16_t)((code << 1) | (*p == '-'));
+        codes[sym] = code;
+        if (decode[code] == 0) decode[code] = (uint16_t)(sym + 1);
+        if (s.name != NULL)
+        {
+            for (int k = 0; s.name[k] != '\0' && k < 11; k++) text[sym][k] = s.name[k];
+            return;
+        }
+        if (s.cp >= CODE_POINTS) throw "code point outside the direct index";
+        utf8(s.cp, text[sym]);
+        if (encode[s.cp] == 0) encode[s.cp] = (uint16_t)(sym + 1);
+        uint32_t lower = lower_case(s.cp);
+        if (lower != s.cp && encode[lower] == 0) encode[lower] = (uint16_t)(sym + 1);
+    }
+
+    /**
+    * Find a seed that gives every prosign its own hash slot.
+    * SEED is the one found for the prosigns here, so the first try
+    * succeeds; a short search is left for changed prosign lists.
+    */
+    template<size_t A, size_t B, size_t C>
+    constexpr void hash_prosigns(const MorseSymbol(&a)[A], const MorseSymbol(&b)[B], const MorseSymbol(&c)[C])
+    {
+        for (uint32_t s = SEED; s < SEED + SEED_TRIES; s++)
+        {
+            uint16_t slots[HASH] = {};
+            bool ok = true;
+            for (int i = 0; i < count && ok; i++)
+            {
+                const MorseSymbol& m = i < (int)A ? a[i] : i < (int)(A + B) ? b[i - A] : c[i - A - B];
+                if (m.name == NULL || m.name[0] != '<') continue;
+                size_t n = 0;
+                while (m.name[n] != '\0') n++;
+                uint32_t h = hash(s, string_view(m.name, n));
+                if (slots[h] != 0) ok = false;
+                slots[h] = (uint16_t)(i + 1);
+            }
+            if (ok)
+            {
+                seed = s;
+                for (int h = 0; h < HASH; h++) prosign[h] = slots[h];
+                return;
+            }
+        }
+        throw "no perfect hash seed for the prosigns, search more seeds and update SEED";
+    }
+
+    static constexpr uint32_t hash(uint32_t s, string_view str)
+    {
+        uint32_t h = 2166136261u ^ s;
+        for (char c : str)
+        {
+            if (c >= 'a' && c <= 'z') c = (char)(c - 32);
+            h = (h ^ (uint8_t)c) * 16777619u;
+        }
+        return (h ^ (h >> 15)) % HASH;
+    }
+
+    static constexpr uint32_t lower_case(uint32_t cp)
+    {
+        if (cp >= 'A' && cp <= 'Z') return cp + 32;
+        if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+        if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+        return cp;
+    }
+
+    static constexpr void utf8(uint32_t cp, char* out)
+    {
+        if (cp < 0x80) { out[0] = (char)cp; return; }
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+    }
+
+public:
+    /**
+    * Read the next symbol from UTF-8 text
+    *
+    * @param str
+    * @param i - position, moved past the symbol
+    * @return int - symbol, SPACE or NONE
+    */
+    constexpr int next(string_view str, size_t& i) const
+    {
+        unsigned char c = (unsigned char)str[i];
+        if (c == ' ' || (c >= '\t' && c <= '\r'))
+        {
+            i++;
+            return SPACE;
+        }
+        if (c == '<')
+        {
+            size_t end = str.find('>', i);
+            if (end != string_view::npos && end - i < 11)
+            {
+                string_view key = str.substr(i, end - i + 1);
+                int sym = prosign[hash(seed, key)] - 1;
+                if (sym >= 0 && same(key, text[sym]))
+                {
+                    i = end + 1;
+                    return sym;
+                }
+            }
+        }
+        uint32_t cp = c;
+        size_t n = 1;
+        if (c >= 0xC0 && c < 0xE0 && i + 1 < str.size() && ((unsigned char)str[i + 1] & 0xC0) == 0x80)
+        {
+            cp = ((c & 0x1F) << 6) | ((unsigned char)str[i + 1] & 0x3F);
+            n = 2;
+        }
+        else if (c >= 0x80)
+        {
+            // longer or broken sequences are outside the direct index, skip the whole sequence
+            while (i + n < str.size() && ((unsigned char)str[i + n] & 0xC0) == 0x80) n++;
+            i += n;
+            return NONE;
+        }
+        i += n;
+        return cp < CODE_POINTS ? encode[cp] - 1 : NONE;
+    }
+
+    /**
+    * Get symbol for a code (leading 1 marker), NONE when unknown
+    *
+    * @param code
+    * @return int
+    */
+    constexpr int symbol(uint32_t code) const
+    {
+        return code < CODES ? decode[code] - 1 : NONE;
+    }
+
+    /**
+    * Get code as string of 0 (dit) and 1 (dah)
+    *
+    * @param sym
+    * @return string
+    */
+    string binary(int sym) const
+    {
+        string bin = "";
+        uint16_t code = codes[sym];
+        int len = 0;
+        while ((code >> len) > 1) len++;
+        for (int k = len - 1; k >= 0; k--) bin += (code >> k) & 1 ? '1' : '0';
+        return bin;
+    }
+
+    /**
+    * Get a compiled table by name
+    *
+    * @param table_name
+    * @return const MorseTable* - NULL when unknown
+    */
+    static const MorseTable* find(const string& table_name);
+
+private:
+    static constexpr bool same(string_view key, const char* name)
+    {
+        size_t k = 0;
+        for (; k < key.size(); k++)
+        {
+            char c = key[k];
+            if (c >= 'a' && c <= 'z') c = (char)(c - 32);
+            if (name[k] != c) return false;
+        }
+        return name[k] == '\0';
+    }
+};
+
+/**
+* The compiled tables
+*/
+inline constexpr MorseTable morse_table_itu = MorseTable::make("itu", morse_latin_letters, morse_common_symbols, morse_prosigns);
+inline constexpr MorseTable morse_table_cyrillic = MorseTable::make("cyrillic", morse_cyrillic_letters, morse_common_symbols, morse_prosigns);
+
+inline const MorseTable* MorseTable::find(const string& table_name)
+{
+    if (table_name == "itu") return &morse_table_itu;
+    if (table_name == "cyrillic") return &morse_table_cyrillic;
+    return NULL;
+}
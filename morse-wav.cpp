@@ -1,9 +1,17 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
+#include <io.h>
+#include "morse-stats.cpp"
+#include "morse-cache.cpp"
+#include "morse-channel.cpp"
+#include "morse-beacon.cpp"
+#include "morse-index.cpp"
 
 using namespace std;
 /**
@@ -33,21 +41,25 @@ private:
 
     PCM16_stereo_t* allocate_PCM16_stereo_buffer(int32_t size)
     {
+        MorseStats::count_alloc();
         return (PCM16_stereo_t*)malloc(sizeof(PCM16_stereo_t) * size);
     }
 
     PCM16_stereo_t* reallocate_PCM16_stereo_buffer(PCM16_stereo_t* buffer, int32_t size)
     {
+        MorseStats::count_alloc();
         return (PCM16_stereo_t*)realloc(buffer, sizeof(PCM16_stereo_t) * size);
     }
 
     PCM16_mono_t* allocate_PCM16_mono_buffer(int32_t size)
     {
+        MorseStats::count_alloc();
         return (PCM16_mono_t*)malloc(sizeof(PCM16_mono_t) * size);
     }
 
     PCM16_mono_t* reallocate_PCM16_mono_buffer(PCM16_mono_t* buffer, int32_t size)
     {
+        MorseStats::count_alloc();
         return (PCM16_mono_t*)realloc(buffer, sizeof(PCM16_mono_t) * size);
     }
 
@@ -56,58 +68,154 @@ private:
     */
 private:
 #define EPW 50      // elements per word (definition)
-    const char* MorseCode; // string array with morse
     int Debug;      // debug mode
     int Play;       // play WAV file
-    int MONO_STEREO = 1;   // stereo or mono modus
-    const char* Path = "morse.wav";    // output filename
-    double Tone;    // tone frequency (Hz)
-    double Wpm;     // words per minute
-    double Eps;     // elements per second (frequency of basic morse element)
-    double Bit;     // duration of basic morse element,cell,quantum (seconds)
-    double Sps;     // samples per second (WAV file, sound card)
+    const int MONO_STEREO;  // stereo or mono modus
+    const double Tone;      // tone frequency (Hz)
+    const double Wpm;       // words per minute
+    const double Eps;       // elements per second (frequency of basic morse element)
+    const double Bit;       // duration of basic morse element,cell,quantum (seconds)
+    const double Sps;       // samples per second (WAV file, sound card)
     PCM16_mono_t* buffer_mono_pcm = NULL; // array with data
     PCM16_stereo_t* buffer_pcm = NULL;
-    long pcm_count; // total number of samples
-    long wav_size;
+    long pcm_count = 0; // total number of samples
+    long pcm_capacity = 0; // samples the buffer holds
+    long wav_size = 0;
+    MorseWavCache* const Cache;     // rendered words, optional, shared
+    string CacheKey;                // tone, wpm, sps, channels and synthesis part of the cache keys
+    const bool Nco;                 // fixed-point synthesis (-nco)
+    MorseChannel* const Channel;    // simulated radio channel, optional, one per MorseWav
+    const uint32_t Step;            // nco phase increment per sample, 2^32 = one cycle
+    MorseIndex* const Index;        // timing index, optional
+    const char* Text = NULL;        // morse text rendering
+#define NCO_TABLE 1024  // quarter-wave sine table entries
+#define NCO_AMPL 32000  // amplitude, same as tone()
 
 public:
     /**
-    * Constructor
+    * Constructor: synthesize the PCM array in memory.
+    * The settings are fixed for the object, all state is per object and
+    * there is no console output, so MorseWav objects can render on many
+    * threads at once. A cache may be shared between threads, a channel
+    * may not (it holds the random generator).
+    *
+    * @param morsecode
+    * @param tone
+    * @param wpm
+    * @param samples_per_second
+    * @param modus
+    * @param cache
+    * @param nco - fixed-point synthesis
+    * @param channel - noise, fading, drift and jitter
+    * @param index - filled with the first sample of every symbol and word
     */
-    MorseWav(const char* morsecode, double tone, double wpm, double samples_per_second, bool play, int modus)
+    MorseWav(const char* morsecode, double tone, double wpm, double samples_per_second, int modus, MorseWavCache* cache = NULL, bool nco = false,
+        MorseChannel* channel = NULL, MorseIndex* index = NULL)
+        : MorseWav(SETTINGS, tone, wpm, samples_per_second, modus, cache, nco, channel, index)
     {
-        string filename = "morse";
-        filename += to_string(time(NULL));
-        filename += ".wav";
-        Path = filename.c_str();
-        MorseCode = morsecode;
-        MONO_STEREO = modus;
-        Wpm = wpm;
-        Tone = tone;
-        Sps = samples_per_second;
-        // Note 60 seconds = 1 minute and 50 elements = 1 morse word.
-        Eps = Wpm / 1.2;    // elements per second (frequency of morse coding)
-        Bit = 1.2 / Wpm;    // seconds per element (period of morse coding)
-        printf("wave: %9.3lf Hz (-sps:%lg)\n", Sps, Sps);
-        printf("tone: %9.3lf Hz (-tone:%lg)\n", Tone, Tone);
-        printf("code: %9.3lf Hz (-wpm:%lg)\n", Eps, Wpm);
-        //show_details();
-        check_ratios();
-        morse_tone(MorseCode);
-        wav_write(Path, buffer_mono_pcm, buffer_pcm, pcm_count);
-        printf("%ld PCM samples", pcm_count);
-        printf(" (%.1lf s @ %.1lf kHz)", (double)pcm_count / Sps, Sps / 1e3);
-        printf(" written to %s (%.1f kB)\n", Path, wav_size / 1024.0);
-        if (play)
+        morse_tone(morsecode);
+        if (Channel != NULL) Channel->apply(pcm_samples(0), pcm_count, MONO_STEREO, Sps, NCO_AMPL);
+        if (Index != NULL)
+        {
+            Index->flags = (Nco ? MorseIndex::NCO : 0) | (Channel != NULL ? MorseIndex::CHANNEL : 0);
+            Index->channels = MONO_STEREO;
+            Index->tone = Tone;
+            Index->wpm = Wpm;
+            Index->sps = Sps;
+            Index->frames = pcm_count;
+        }
+    }
+
+    /**
+    * Constructor: synthesize a beacon encoded at compile time.
+    * tone() runs straight from the keying runs, without parsing and table
+    * lookups, and the PCM array is allocated once for the known sample count.
+    *
+    * @param beacon
+    * @param hz - tone frequency
+    * @param wpm
+    * @param samples_per_second
+    * @param modus
+    * @param nco - fixed-point synthesis
+    */
+    template<size_t N>
+    MorseWav(const MorseBeacon<N>& beacon, double hz, double wpm, double samples_per_second, int modus, bool nco = false)
+        : MorseWav(SETTINGS, hz, wpm, samples_per_second, modus, NULL, nco, NULL, NULL)
+    {
+        MorseStats::Scope scope(MorseStats::SYNTH, beacon.morse_size);
+        reserve_pcm(beacon.samples(wpm, samples_per_second));
+        for (int r = 0; r < beacon.run_count; r++)
         {
-            string str = Path;
-            str += " /play /close ";
-            str += Path;
-            const char* c = str.c_str();
-            printf("** %s\n", c);
-            system(c);
+            int on_off = beacon.runs[r] > 0;
+            for (int k = on_off ? beacon.runs[r] : -beacon.runs[r]; k > 0; k--) tone(on_off);
         }
+        scope.out = pcm_count * MONO_STEREO * sizeof(int16_t);
+    }
+
+private:
+    /**
+    * Constructor: the settings only, nothing rendered (and nothing counted
+    * in the stats), the public constructors render
+    */
+    enum Settings { SETTINGS };
+
+    MorseWav(Settings, double tone, double wpm, double samples_per_second, int modus, MorseWavCache* cache, bool nco,
+        MorseChannel* channel, MorseIndex* index)
+        : MONO_STEREO(modus), Tone(tone), Wpm(wpm),
+        // Note 60 seconds = 1 minute and 50 elements = 1 morse word.
+        Eps(wpm / 1.2),     // elements per second (frequency of morse coding)
+        Bit(1.2 / wpm),     // seconds per element (period of morse coding)
+        Sps(samples_per_second), Cache(cache), Nco(nco), Channel(channel), Step(nco_step(tone)), Index(index)
+    {
+    }
+
+public:
+    MorseWav(const MorseWav&) = delete;
+    MorseWav& operator=(const MorseWav&) = delete;
+
+    /**
+    * Destructor
+    */
+    ~MorseWav()
+    {
+        free(buffer_mono_pcm);
+        free(buffer_pcm);
+    }
+
+public:
+    /**
+    * Get number of PCM samples (frames) rendered
+    *
+    * @return long
+    */
+    long get_pcm_count() const { return pcm_count; }
+
+    /**
+    * Get rendered PCM array, interleaved int16 samples (left, right when stereo)
+    *
+    * @return const int16_t*
+    */
+    const int16_t* get_pcm_data() const
+    {
+        if (MONO_STEREO == 1) return (const int16_t*)buffer_mono_pcm;
+        return (const int16_t*)buffer_pcm;
+    }
+
+    /**
+    * Get number of samples in one morse element (quantum)
+    *
+    * @return long
+    */
+    long get_samples_per_element() const { return (long)(Bit * Sps); }
+
+    /**
+    * Count sub-optimal combinations of rates, see check_ratios()
+    *
+    * @return int
+    */
+    int ratio_warnings() const
+    {
+        return ratio_poor(Sps, Tone) + ratio_poor(Sps, Eps) + ratio_poor(Tone, Eps);
     }
 
 private:
@@ -120,59 +228,146 @@ private:
     */
     void tone(int on_off)
     {
+        double hz = Channel != NULL ? Channel->frequency(Tone, pcm_count / Sps) : Tone;
+        long n;
+        n = (long)(Bit * Sps);
+        if (Channel != NULL) n = Channel->quantum(n);
+        reserve_pcm(n);
+        quantum(pcm_samples(pcm_count), n, MONO_STEREO, on_off, hz, Sps, Nco, Nco && Channel != NULL ? nco_step(hz) : Step);
+        pcm_count += n;
+    }
+
+public:
+    /**
+    * Render one quantum of silence or tone, the phase starts at 0 every
+    * quantum. Used by tone() and by MorseStream for its key down quantum.
+    *
+    * Floating point: y(t) = amplitude * sin(2 * PI * frequency * time).
+    * Fixed point (nco) for hosts without a fast FPU: 32-bit phase
+    * accumulator, quarter-wave sine table with linear interpolation, Q15
+    * amplitude and envelope, integer only per sample. The result stays
+    * within 1 LSB of the floating point one, so words can be cached the
+    * same way. The accumulator restarts at 0 every quantum like the
+    * floating point phase: nco saves the FPU, it is not continuous phase,
+    * a quantum that does not end on a whole cycle clicks the same way.
+    *
+    * @param out - interleaved, n * channels
+    * @param n - samples in the quantum
+    * @param channels
+    * @param on_off
+    * @param hz
+    * @param sps
+    * @param nco - fixed-point synthesis
+    * @param step - nco phase increment, nco_step(hz, sps)
+    */
+    static void quantum(int16_t* out, long n, int channels, int on_off, double hz, double sps, bool nco, uint32_t step)
+    {
+        if (on_off == 0)
+        {
+            memset(out, 0, n * channels * sizeof(int16_t));
+            return;
+        }
         double ampl = 32000.0; // amplitude 32KHz for digital sound (max height of wave)
         double pi = 3.1415926535897932384626433832795;
-        double w = 2.0 * pi * Tone;
-        long i, n, size;
-        static long seconds;
-        if (MONO_STEREO == 1) // mono
+        double w = 2.0 * pi * hz;
+        const int32_t* quarter = sine_quarter();
+        const int32_t envelope = 32768; // Q15, key down
+        uint32_t phase = 0;
+        for (long i = 0; i < n; i++, phase += step)
         {
-            if (buffer_mono_pcm == NULL)
+            int16_t sample;
+            if (nco)
             {
-                seconds = 1;
-                size = (seconds * sizeof buffer_mono_pcm * Sps);
-                buffer_mono_pcm = allocate_PCM16_mono_buffer(size);
+                int32_t sine = nco_sine(quarter, phase);
+                int32_t v = ((((sine < 0 ? -sine : sine) * NCO_AMPL) >> 15) * envelope) >> 15;
+                sample = (int16_t)(sine < 0 ? -v : v);
             }
-        }
-        else // stereo
-        {
-            if (buffer_pcm == NULL)
+            else
             {
-                seconds = 1;
-                size = (seconds * sizeof buffer_pcm * Sps);
-                buffer_pcm = allocate_PCM16_stereo_buffer(size);
+                // generate one point on the sine wave
+                double t = (double)i / sps;
+                sample = (int16_t)(ampl * sin(w * t));
             }
+            for (int c = 0; c < channels; c++) out[i * channels + c] = sample;
         }
-        n = (long)(Bit * Sps);
-        for (i = 0; i < n; i++)
+    }
+
+public:
+    /**
+    * Get the sine of an nco phase, Q15 (32768 = 1.0).
+    * Quadrant in the top 2 bits, table index in the next 10, interpolation in the next 16.
+    *
+    * @param quarter - sine_quarter()
+    * @param phase - 2^32 = one cycle
+    * @return int32_t
+    */
+    static int32_t nco_sine(const int32_t* quarter, uint32_t phase)
+    {
+        uint32_t x = phase & 0x3FFFFFFF;
+        if (phase & 0x40000000) x = 0x40000000 - x;
+        uint32_t k = x >> 20;
+        int32_t frac = (int32_t)((x >> 4) & 0xFFFF);
+        int32_t sine = quarter[k] + (((quarter[k + 1] - quarter[k]) * frac) >> 16);
+        return phase & 0x80000000 ? -sine : sine;
+    }
+
+    /**
+    * Quarter-wave sine table, Q15 (32768 = 1.0), one guard entry for the interpolation
+    *
+    * @return const int32_t*
+    */
+    static const int32_t* sine_quarter()
+    {
+        struct Table
         {
-            double t = (double)i / Sps;
-            if (MONO_STEREO == 1) // MONO
-            {
-                double t = (double)i / Sps;
-                if (pcm_count == Sps * seconds)
-                {
-                    seconds++;
-                    size = (seconds * sizeof buffer_mono_pcm * Sps);
-                    buffer_mono_pcm = reallocate_PCM16_mono_buffer(buffer_mono_pcm, size);
-                }
-                // generate one point on the sine wave
-                buffer_mono_pcm[pcm_count++].speaker = (int16_t)(on_off * ampl * sin(w * t));
-            }
-            else // STEREO
+            int32_t v[NCO_TABLE + 2];
+            Table()
             {
-                if (pcm_count == Sps * seconds)
-                {
-                    seconds++;
-                    size = (seconds * sizeof buffer_pcm * Sps);
-                    buffer_pcm = reallocate_PCM16_stereo_buffer(buffer_pcm, size);
-                }
-                pcm_count++;
-                // generate one point on the sine wave for left and right
-                buffer_pcm[pcm_count].left = (int16_t)(on_off * ampl * sin(w * t));
-                buffer_pcm[pcm_count].right = (int16_t)(on_off * ampl * sin(w * t));
+                for (int k = 0; k <= NCO_TABLE; k++) v[k] = (int32_t)lround(32768.0 * sin(1.5707963267948966 * k / NCO_TABLE));
+                v[NCO_TABLE + 1] = v[NCO_TABLE];
             }
+        };
+        static const Table table;
+        return table.v;
+    }
+
+    /**
+    * Get the nco phase increment per sample for a tone at Sps
+    *
+    * @param hz
+    * @return uint32_t
+    */
+    uint32_t nco_step(double hz) const
+    {
+        return nco_step(hz, Sps);
+    }
+
+    static uint32_t nco_step(double hz, double sps)
+    {
+        return (uint32_t)llround(fmod(hz / sps, 1.0) * 4294967296.0);
+    }
+
+private:
+    /**
+    * Make room for more samples in the PCM array,
+    * grow by doubling and by at least one second.
+    *
+    * @param frames
+    */
+    void reserve_pcm(long frames)
+    {
+        if (pcm_count + frames <= pcm_capacity) return;
+        long size = pcm_capacity * 2 > (long)Sps ? pcm_capacity * 2 : (long)Sps;
+        while (size < pcm_count + frames) size *= 2;
+        if (MONO_STEREO == 1) // mono
+        {
+            buffer_mono_pcm = buffer_mono_pcm == NULL ? allocate_PCM16_mono_buffer(size) : reallocate_PCM16_mono_buffer(buffer_mono_pcm, size);
         }
+        else // stereo
+        {
+            buffer_pcm = buffer_pcm == NULL ? allocate_PCM16_stereo_buffer(size) : reallocate_PCM16_stereo_buffer(buffer_pcm, size);
+        }
+        pcm_capacity = size;
     }
 
 private:
@@ -190,40 +385,146 @@ private:
     void space() { tone(0); tone(0); }
 
     /**
-    * Create Tones from morse code.
+    * Create Tones from morse code, word by word.
+    * A word is everything up to a run of two or more spaces.
     *
     * @param code
     */
     void morse_tone(const char* code)
     {
-        char c;
-        while ((c = *code++) != '\0')
+        MorseStats::Scope scope(MorseStats::SYNTH, strlen(code));
+        Text = code;
+        if (Index != NULL)
         {
-            //printf("%c", c);
-            if (c == '.') dit();
-            if (c == '-') dah();
-            if (c == ' ') space();
+            Index->clear();
+            Index->morse = code;
         }
+        long gap = 0; // a word starts with the gap before it
+        while (*code != '\0')
+        {
+            const char* end = strstr(code, "  ");
+            if (end == NULL) end = code + strlen(code);
+            if (Index != NULL && end > code) Index->add_word(gap);
+            word_tone(code, end - code);
+            gap = pcm_count;
+            for (code = end; *code == ' '; code++) space();
+        }
+        scope.out = pcm_count * MONO_STEREO * sizeof(int16_t);
     }
 
-private:
+    /**
+    * Create Tones for one word, copied from the word cache when it is there.
+    *
+    * @param word
+    * @param size
+    */
+    void word_tone(const char* word, size_t size)
+    {
+        string key = "";
+        if (Cache != NULL && size > 0 && (Channel == NULL || !Channel->timing()))
+        {
+            if (CacheKey.empty())
+            {
+                char params[96];
+                snprintf(params, sizeof params, "|%a|%a|%a|%d|%d", Tone, Wpm, Sps, MONO_STEREO, (int)Nco);
+                CacheKey = params;
+            }
+            key.assign(word, size);
+            key += CacheKey;
+            MorseWavCache::Pcm pcm = Cache->get(key);
+            if (pcm != NULL)
+            {
+                if (Index != NULL) index_word(word, size);
+                long frames = (long)pcm->size() / MONO_STEREO;
+                reserve_pcm(frames);
+                memcpy(pcm_samples(pcm_count), pcm->data(), pcm->size() * sizeof(int16_t));
+                pcm_count += frames;
+                return;
+            }
+        }
+        long start = pcm_count;
+        for (size_t i = 0; i < size; i++)
+        {
+            if (Index != NULL && symbol_start(word, i)) Index->add_symbol(pcm_count, word + i - Text);
+            if (word[i] == '.') dit();
+            if (word[i] == '-') dah();
+            if (word[i] == ' ') space();
+        }
+        if (!key.empty())
+        {
+            Cache->put(key, make_shared<const vector<int16_t>>(pcm_samples(start), pcm_samples(pcm_count)));
+        }
+    }
+
+    /**
+    * Index the symbols of a word copied from the cache, no timing changes
+    * on that path, so their samples follow from the element counts
+    *
+    * @param word
+    * @param size
+    */
+    void index_word(const char* word, size_t size)
+    {
+        long n = (long)(Bit * Sps), sample = pcm_count;
+        for (size_t i = 0; i < size; i++)
+        {
+            if (symbol_start(word, i)) Index->add_symbol(sample, word + i - Text);
+            if (word[i] == '.' || word[i] == ' ') sample += 2 * n;
+            if (word[i] == '-') sample += 4 * n;
+        }
+    }
+
+    static bool symbol_start(const char* word, size_t i)
+    {
+        return (word[i] == '.' || word[i] == '-') && (i == 0 || word[i - 1] == ' ');
+    }
+
+    /**
+    * Get sample position in the PCM array, mono or interleaved stereo
+    *
+    * @param frame
+    * @return int16_t*
+    */
+    int16_t* pcm_samples(long frame) const
+    {
+        if (MONO_STEREO == 1) return (int16_t*)buffer_mono_pcm + frame;
+        return (int16_t*)buffer_pcm + 2 * frame;
+    }
+
+public:
     /**
     * Check for sub-optimal combination of rates (poor sounding sinewaves).
+    *
+    * @param out
+    */
+    void check_ratios(FILE* out) const
+    {
+        check_ratios(out, Sps, Tone, Eps);
+    }
+
+    /**
+    * Check rates before rendering (see MorseStream). The same warnings
+    * hold with nco, the phase restarts every quantum there too.
+    *
+    * @param out
+    * @param sps
+    * @param tone
+    * @param eps - elements per second, wpm / 1.2
     */
-    void check_ratios()
+    static void check_ratios(FILE* out, double sps, double tone, double eps)
     {
         char nb[] = "WARNING: sub-optimal sound ratio";
-        if (ratio_poor(Sps, Tone))
+        if (ratio_poor(sps, tone))
         {
-            printf("%s Sps(%lg) / Tone(%lg) = %.6lf\n", nb, Sps, Tone, Sps / Tone);
+            fprintf(out, "%s Sps(%lg) / Tone(%lg) = %.6lf\n", nb, sps, tone, sps / tone);
         }
-        if (ratio_poor(Sps, Eps))
+        if (ratio_poor(sps, eps))
         {
-            printf("%s Sps(%lg) / Eps(%lg) = %.6lf\n", nb, Sps, Eps, Sps / Eps);
+            fprintf(out, "%s Sps(%lg) / Eps(%lg) = %.6lf\n", nb, sps, eps, sps / eps);
         }
-        if (ratio_poor(Tone, Eps))
+        if (ratio_poor(tone, eps))
         {
-            printf("%s Tone(%lg) / Eps(%lg) = %.6lf\n", nb, Tone, Eps, Tone / Eps);
+            fprintf(out, "%s Tone(%lg) / Eps(%lg) = %.6lf\n", nb, tone, eps, tone / eps);
         }
     }
 
@@ -235,55 +536,56 @@ private:
     * @param b
     * @return int
     */
-    int ratio_poor(double a, double b)
+    static int ratio_poor(double a, double b)
     {
         double ab = a / b;
         long ratio = (long)(ab + 1e-6);
         return fabs(ab - ratio) > 1e-4;
     }
 
-private:
+public:
     /**
     * Display detailed data
+    *
+    * @param out
     */
-    void show_details()
+    void show_details(FILE* out) const
     {
         double wps, ms;
-        wps = Wpm / 60.0;   // words per second
-        Eps = EPW * wps;    // elements per second
+        wps = Wpm / 60.0;   // words per second, Eps = EPW * wps
         ms = 1000.0 / Eps;  // milliseconds per element
-        printf("\n");
-        printf("%12.6lf Wpm (words per minute)\n", Wpm);
-        printf("%12.6lf wps (words per second)\n", wps);
-        printf("%12.6lf EPW (elements per word)\n", (double)EPW);
-        printf("%12.6lf Eps (elements per second)\n", Eps);
-        printf("\n");
-        printf("%12.3lf ms dit\n", ms);
-        printf("%12.3lf ms dah\n", ms * 3);
-        printf("%12.3lf ms gap (element)\n", ms);
-        printf("%12.3lf ms gap (character)\n", ms * 3);
-        printf("%12.3lf ms gap (word)\n", ms * 7);
-        printf("\n");
-        printf("%12.3lf Hz pcm frequency\n", Sps);
-        printf("%12.3lf Hz tone frequency\n", Tone);
-        printf("%12.3lf    pcm/tone ratio\n", Sps / Tone);
-        printf("\n");
-        printf("%12.3lf Hz pcm frequency\n", Sps);
-        printf("%12.3lf Hz element frequency\n", Eps);
-        printf("%12.3lf    pcm/element ratio\n", Sps / Eps);
-        printf("\n");
-        printf("%12.3lf Hz tone frequency\n", Tone);
-        printf("%12.3lf Hz element frequency\n", Eps);
-        printf("%12.3lf    tone/element ratio\n", Tone / Eps);
-        printf("\n");
+        fprintf(out, "\n");
+        fprintf(out, "%12.6lf Wpm (words per minute)\n", Wpm);
+        fprintf(out, "%12.6lf wps (words per second)\n", wps);
+        fprintf(out, "%12.6lf EPW (elements per word)\n", (double)EPW);
+        fprintf(out, "%12.6lf Eps (elements per second)\n", Eps);
+        fprintf(out, "\n");
+        fprintf(out, "%12.3lf ms dit\n", ms);
+        fprintf(out, "%12.3lf ms dah\n", ms * 3);
+        fprintf(out, "%12.3lf ms gap (element)\n", ms);
+        fprintf(out, "%12.3lf ms gap (character)\n", ms * 3);
+        fprintf(out, "%12.3lf ms gap (word)\n", ms * 7);
+        fprintf(out, "\n");
+        fprintf(out, "%12.3lf Hz pcm frequency\n", Sps);
+        fprintf(out, "%12.3lf Hz tone frequency\n", Tone);
+        fprintf(out, "%12.3lf    pcm/tone ratio\n", Sps / Tone);
+        fprintf(out, "\n");
+        fprintf(out, "%12.3lf Hz pcm frequency\n", Sps);
+        fprintf(out, "%12.3lf Hz element frequency\n", Eps);
+        fprintf(out, "%12.3lf    pcm/element ratio\n", Sps / Eps);
+        fprintf(out, "\n");
+        fprintf(out, "%12.3lf Hz tone frequency\n", Tone);
+        fprintf(out, "%12.3lf Hz element frequency\n", Eps);
+        fprintf(out, "%12.3lf    tone/element ratio\n", Tone / Eps);
+        fprintf(out, "\n");
     }
 
 private:
     /**
     * Create WAV file from PCM array.
     */
-    typedef unsigned short WORD;
-    typedef unsigned long DWORD;
+    typedef uint16_t WORD;
+    typedef uint32_t DWORD;
     typedef struct _wave
     {
         WORD  wFormatTag;      // format type
@@ -299,46 +601,196 @@ private:
     wav_size += size; \
     if (fwrite(buffer, size, 1, file) != 1) { \
         fprintf(stderr, "Write failed: %s\n", path); \
-        exit(1); \
+        fclose(file); \
+        return false; \
     }
 
+public:
     /**
-    * Write wav file
+    * Get WAV file header (RIFF, fmt and data chunk headers) for count PCM samples
     *
-    * @param path
-    * @param data
     * @param count
+    * @return string
     */
-    void wav_write(const char* path, PCM16_mono_t* buffer_mono_pcm, PCM16_stereo_t* buffer_pcm, long count)
+    string wav_header(long count) const
     {
-        long data_size, wave_size, riff_size;
+        return wav_header(count, MONO_STEREO, Sps);
+    }
+
+    /**
+    * Get WAV file header for count PCM samples of any layout (see MorseMix)
+    *
+    * @param count
+    * @param channels
+    * @param sps
+    * @return string
+    */
+    static string wav_header(long count, int channels, double sps)
+    {
+        int32_t data_size, wave_size, riff_size;
         int fmt_size = 16;
-        FILE* file;
         WAVE wave;
+        memset(&wave, 0, sizeof wave);
         wave.wFormatTag = 0x1;
-        wave.nChannels = MONO_STEREO; // 1 or 2 ~ mono or stereo
+        wave.nChannels = channels; // 1 or 2 ~ mono or stereo
         wave.wBitsPerSample = 16; // 8 or 16
         wave.nBlockAlign = (wave.wBitsPerSample * wave.nChannels) / 8;
-        wave.nSamplesPerSec = Sps;
+        wave.nSamplesPerSec = (DWORD)sps;
         wave.nAvgBytesPerSec = wave.nSamplesPerSec * wave.nBlockAlign;
         wave.cbSize = 0;
         wave_size = sizeof wave;
         data_size = (count * wave.wBitsPerSample * wave.nChannels) / 8;
         riff_size = fmt_size + wave_size + data_size; // 36 + data_size
+        string header = "";
+        header.append("RIFF", 4);
+        header.append((const char*)&riff_size, 4);
+        header.append("WAVE", 4);
+        header.append("fmt ", 4);
+        header.append((const char*)&wave_size, 4);
+        header.append((const char*)&wave, wave_size);
+        header.append("data", 4);
+        header.append((const char*)&data_size, 4);
+        return header;
+    }
+
+public:
+    /**
+    * Write the rendered PCM to a WAV file
+    *
+    * @param path
+    * @return long - bytes written, -1 on failure
+    */
+    long save(const char* path)
+    {
+        return wav_write(path, buffer_mono_pcm, buffer_pcm, pcm_count) ? wav_size : -1;
+    }
+
+public:
+    /**
+    * Replace the samples [from, to) of a WAV file written by save() with
+    * other samples, in place. The samples after them are moved only when
+    * the length changes.
+    *
+    * @param path
+    * @param channels
+    * @param sps
+    * @param count - samples in the file
+    * @param from
+    * @param to
+    * @param pcm - interleaved samples
+    * @param frames
+    * @return bool
+    */
+    static bool wav_patch(const char* path, int channels, double sps, long count, long from, long to, const int16_t* pcm, long frames)
+    {
+        MorseStats::Scope scope(MorseStats::WAV_WRITE, frames * channels * sizeof(int16_t));
+        string header = wav_header(count, channels, sps);
+        long head = (long)header.size(), frame = channels * (long)sizeof(int16_t);
+        FILE* file;
+#pragma warning(suppress : 4996)
+        if ((file = fopen(path, "r+b")) == NULL)
+        {
+            fprintf(stderr, "Open failed: %s\n", path);
+            return false;
+        }
+        string old(header.size(), '\0');
+        bool ok = fseek(file, 0, SEEK_END) == 0 && ftell(file) == head + count * frame && fseek(file, 0, SEEK_SET) == 0 &&
+            fread(&old[0], old.size(), 1, file) == 1 && old == header;
+        if (!ok)
+        {
+            fprintf(stderr, "Not the WAV file of the index: %s\n", path);
+            fclose(file);
+            return false;
+        }
+        vector<int16_t> tail;
+        if (frames != to - from && to < count)
+        {
+            tail.resize((size_t)(count - to) * channels);
+            ok = fseek(file, head + to * frame, SEEK_SET) == 0 && fread(tail.data(), tail.size() * sizeof(int16_t), 1, file) == 1;
+        }
+        long size = count - (to - from) + frames;
+        header = wav_header(size, channels, sps);
+        ok = ok && fseek(file, head + from * frame, SEEK_SET) == 0 && (frames == 0 || fwrite(pcm, frames * frame, 1, file) == 1) &&
+            (tail.empty() || fwrite(tail.data(), tail.size() * sizeof(int16_t), 1, file) == 1) &&
+            fseek(file, 0, SEEK_SET) == 0 && fwrite(header.data(), header.size(), 1, file) == 1 && fflush(file) == 0;
+        if (ok && size < count) ok = _chsize_s(_fileno(file), head + size * frame) == 0;
+        if (fclose(file) != 0) ok = false;
+        if (!ok) fprintf(stderr, "Write failed: %s\n", path);
+        scope.out = (frames + tail.size() / channels) * frame;
+        return ok;
+    }
+
+    /**
+    * Find the PCM samples of a 16 bit WAV file in memory (mapped by MorseFile)
+    *
+    * @param wav - file bytes
+    * @param pcm - interleaved samples, into wav
+    * @param frames
+    * @param channels
+    * @param sps
+    * @return bool - false when it is not a 16 bit PCM WAV file
+    */
+    static bool wav_pcm(string_view wav, const int16_t*& pcm, long& frames, int& channels, double& sps)
+    {
+        int bits = 0;
+        const char* data = NULL;
+        size_t size = 0;
+        channels = 0;
+        sps = 0;
+        if (wav.size() < 12 || wav.compare(0, 4, "RIFF") != 0 || wav.compare(8, 4, "WAVE") != 0) return false;
+        for (size_t pos = 12; pos + 8 <= wav.size();)
+        {
+            uint32_t chunk;
+            memcpy(&chunk, wav.data() + pos + 4, 4);
+            string_view id = wav.substr(pos, 4);
+            size_t body = pos + 8;
+            if (id == "fmt " && chunk >= 16 && body + 16 <= wav.size())
+            {
+                uint16_t format, ch, bps;
+                uint32_t rate;
+                memcpy(&format, wav.data() + body, 2);
+                memcpy(&ch, wav.data() + body + 2, 2);
+                memcpy(&rate, wav.data() + body + 4, 4);
+                memcpy(&bps, wav.data() + body + 14, 2);
+                if (format == 1) { channels = ch; bits = bps; sps = rate; }
+            }
+            if (id == "data")
+            {
+                data = wav.data() + body;
+                size = chunk < wav.size() - body ? chunk : wav.size() - body;
+                break;
+            }
+            pos = body + chunk + (chunk & 1);
+        }
+        if (data == NULL || bits != 16 || channels < 1 || sps <= 0 || ((uintptr_t)data & 1) != 0) return false;
+        pcm = (const int16_t*)data;
+        frames = (long)(size / (2 * channels));
+        return true;
+    }
+
+private:
+    /**
+    * Write wav file
+    *
+    * @param path
+    * @param data
+    * @param count
+    * @return bool
+    */
+    bool wav_write(const char* path, PCM16_mono_t* buffer_mono_pcm, PCM16_stereo_t* buffer_pcm, long count)
+    {
+        wav_size = 0;
+        MorseStats::Scope scope(MorseStats::WAV_WRITE, count * MONO_STEREO * sizeof(int16_t));
+        string header = wav_header(count);
+        long data_size = (count * 16 * MONO_STEREO) / 8;
+        FILE* file;
 #pragma warning(suppress : 4996)
         if ((file = fopen(path, "wb")) == NULL)
         {
             fprintf(stderr, "Open failed: %s\n", path);
-            exit(1);
+            return false;
         }
-        FWRITE("RIFF", 4);
-        FWRITE(&riff_size, 4);
-        FWRITE("WAVE", 4);
-        FWRITE("fmt ", 4);
-        FWRITE(&wave_size, 4);
-        FWRITE(&wave, wave_size);
-        FWRITE("data", 4);
-        FWRITE(&data_size, 4);
+        FWRITE(header.data(), header.size());
         if (MONO_STEREO == 1)
         {
             FWRITE(buffer_mono_pcm, data_size);
@@ -348,5 +800,7 @@ private:
             FWRITE(buffer_pcm, data_size);
         }
         fclose(file);
+        scope.out = wav_size;
+        return true;
     }
 };
\ No newline at end of file
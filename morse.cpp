@@ -4,8 +4,25 @@
 #include <iterator>
 #include <vector>
 #include <regex>
+#include <string_view>
+#include <winsock2.h>
 #include <windows.h>
 #include "Morse-Wav.cpp"
+#include "morse-file.cpp"
+#include "morse-stats.cpp"
+#include "morse-tables.cpp"
+#include "morse-spectrum.cpp"
+#include "morse-mix.cpp"
+#include "morse-stream.cpp"
+#include "morse-beacon.cpp"
+#include "morse-beam.cpp"
+
+/**
+* Beacon text of the bc modus, encoded at compile time, /DMORSE_BEACON="..."
+*/
+#ifndef MORSE_BEACON
+#define MORSE_BEACON "VVV VVV DE MORSE <AR>"
+#endif
 
 using namespace std;
 /**
@@ -33,9 +50,29 @@ private:
 public:
 	double frequency_in_hertz = 880.0;// 880 Hz music note A5 - 440 cycles every second
 	double words_per_minute = 16.0;//words per minute
+	// cmd line limits, also of the settings in a timing index (MorseIndex::valid)
 	double max_frequency_in_hertz = 8000.0;
 	double min_frequency_in_hertz = 37.0;
+	double max_words_per_minute = 50.0;
+	double min_words_per_minute = 1.0;
 	double samples_per_second = 44100.0;
+	double max_samples_per_second = 48000.0;
+	double min_samples_per_second = 8000.0;
+	string input_file = "";// -in:<file> for the text modes
+	string output_file = "";// -out:<file> for the text modes
+	string socket_path = "";// -sock:<file> unix domain socket of the morse server
+	int threads = 4;// -threads:<n> workers of the morse server
+	bool nco = false;// -nco fixed-point synthesis
+	MorseChannel::Params channel;// -snr: -qsb: -drift: -jitter: simulated radio channel
+	unsigned long seed = 1;// -seed:<n> random seed of the channel and of rt
+	int count = 1;// -count:<n> wav files rendered through the channel
+	int fft_size = 1024;// -fft:<n> spectrogram frame size
+	int fft_hop = 0;// -hop:<n> spectrogram frame step, 0 for half a frame
+	bool index = false;// -index timing index <wav>.idx next to the wav files
+	string records = "";// -rec[:nl|nul|len] record mode framing, see MorseRecords
+	int beam = 16;// -beam:<n> hypotheses of the beam search decoder (bd)
+	string dictionary = "";// -dict:<file> words and callsigns, prior of the beam search decoder
+	string language = "";// -lm:<file> text the character bigram prior of the beam search decoder is trained on
 	/**
 	* Constructor
 	*/
@@ -44,88 +81,67 @@ public:
 
 private:
 	/**
-	* Fill Multimaps with morse tables
+	* Selected code table, compiled (see morse-tables.cpp), and its codes
+	* per symbol and modus (morse, binary, hex, hex binary)
 	*/
-	multimap <string, string> morse_map;
-	multimap <string, string> morse_map_reversed;
+	const MorseTable* table = &morse_table_itu;
+	vector <string> encode_index[4];
 	void fill_morse_maps()
 	{
-		morse_map.insert(pair <string, string>(" ", ""));        // SPACE (0b1)
-		morse_map.insert(pair <string, string>("!", "101011"));  // -.-.--
-		morse_map.insert(pair <string, string>("$", "0001001")); // ...-..-
-		morse_map.insert(pair <string, string>("\"", "010010")); // .-..-.
-
-		morse_map.insert(pair <string, string>("'", "011110"));  // .----.
-		morse_map.insert(pair <string, string>("(", "10110"));   // -.--.
-		morse_map.insert(pair <string, string>(")", "101101"));  // -.--.-
-
-		morse_map.insert(pair <string, string>(",", "110011"));  // --..--
-		morse_map.insert(pair <string, string>("-", "100001"));  // -....-
-		morse_map.insert(pair <string, string>(".", "010101"));  // .-.-.-
-		morse_map.insert(pair <string, string>("/", "10010"));   // -..-.
-
-		morse_map.insert(pair <string, string>("0", "11111"));   // -----
-		morse_map.insert(pair <string, string>("1", "01111"));   // .----
-		morse_map.insert(pair <string, string>("2", "00111"));   // ..---
-		morse_map.insert(pair <string, string>("3", "00011"));   // ...--
-		morse_map.insert(pair <string, string>("4", "00001"));   // ....-
-		morse_map.insert(pair <string, string>("5", "00000"));   // .....
-		morse_map.insert(pair <string, string>("6", "10000"));   // -....
-		morse_map.insert(pair <string, string>("7", "11000"));   // --...
-		morse_map.insert(pair <string, string>("8", "11100"));   // ---..
-		morse_map.insert(pair <string, string>("9", "11110"));   // ----.
-
-		morse_map.insert(pair <string, string>(":", "111000"));  // ---...
-		morse_map.insert(pair <string, string>(";", "101010"));  // -.-.-.
-		morse_map.insert(pair <string, string>("=", "10001"));   // -...-
-		morse_map.insert(pair <string, string>("?", "001100"));  // ..--..
-		morse_map.insert(pair <string, string>("@", "011010"));  // .--.-.
-
-		morse_map.insert(pair <string, string>("A", "01"));      // .-
-		morse_map.insert(pair <string, string>("B", "1000"));    // -...
-		morse_map.insert(pair <string, string>("C", "1010"));    // -.-.
-		morse_map.insert(pair <string, string>("D", "100"));     // -..
-		morse_map.insert(pair <string, string>("E", "0"));       // .
-		morse_map.insert(pair <string, string>("F", "0010"));    // ..-.
-		morse_map.insert(pair <string, string>("G", "110"));     // --.
-		morse_map.insert(pair <string, string>("H", "0000"));    // ....
-		morse_map.insert(pair <string, string>("I", "00"));      // ..
-		morse_map.insert(pair <string, string>("J", "0111"));    // .---
-		morse_map.insert(pair <string, string>("K", "101"));     // -.-
-		morse_map.insert(pair <string, string>("L", "0100"));    // .-..
-		morse_map.insert(pair <string, string>("M", "11"));      // --
-		morse_map.insert(pair <string, string>("N", "10"));      // -.
-		morse_map.insert(pair <string, string>("O", "111"));     // ---
-		morse_map.insert(pair <string, string>("P", "0110"));    // .--.
-		morse_map.insert(pair <string, string>("Q", "1101"));    // --.-
-		morse_map.insert(pair <string, string>("R", "010"));     // .-.
-		morse_map.insert(pair <string, string>("S", "000"));     // ...
-		morse_map.insert(pair <string, string>("T", "1"));       // -
-		morse_map.insert(pair <string, string>("U", "001"));     // ..-
-		morse_map.insert(pair <string, string>("V", "0001"));    // ...-
-		morse_map.insert(pair <string, string>("W", "011"));     // .--
-		morse_map.insert(pair <string, string>("X", "1001"));    // -..-
-		morse_map.insert(pair <string, string>("Y", "1011"));    // -.--
-		morse_map.insert(pair <string, string>("Z", "1100"));    // --..
-		morse_map.insert(pair <string, string>("_", "001101"));  // ..--.-
-		morse_map.insert(pair <string, string>("ERR", "00000000")); // ........
-		// invert morse_map
-		for (const auto& it : morse_map)
-		{
-			morse_map_reversed.insert(make_pair(it.second, it.first));
+		const char* hex[] = { "2E", "2D", "30", "31" };
+		for (int modus = 0; modus < 4; modus++)
+		{
+			encode_index[modus].assign(table->count, "");
 		}
+		for (int sym = 0; sym < table->count; sym++)
+		{
+			string bin = table->binary(sym);
+			string hx[2] = { "", "" };
+			for (char b : bin)
+			{
+				for (int h = 0; h < 2; h++)
+				{
+					if (!hx[h].empty()) hx[h] += " ";
+					hx[h] += hex[2 * h + (b == '1')];
+				}
+			}
+			string codes[4] = { strtr(bin, "01", ".-"), bin, hx[0], hx[1] };
+			for (int modus = 0; modus < 4; modus++)
+			{
+				encode_index[modus][sym] = codes[modus];
+			}
+		}
+	}
+
+public:
+	/**
+	* Select the code table (-table:itu, -table:cyrillic)
+	*
+	* @param name
+	* @return bool - false when there is no such table
+	*/
+	bool set_table(const string& name)
+	{
+		const MorseTable* t = MorseTable::find(name);
+		if (t == NULL) return false;
+		table = t;
+		fill_morse_maps();
+		return true;
 	}
 
 private:
 	/**
 	* Get binary morse code (dit/dah) for a given character
+	* (UTF-8, or a prosign like <SK>), empty when not in the table
 	*
 	* @param character
 	* @return string
 	*/
-	string getBinChar(string character)
+	string getBinChar(string character) const
 	{
-		return morse_map.find(character)->second;
+		size_t i = 0;
+		int sym = character.empty() ? MorseTable::NONE : table->next(character, i);
+		return sym >= 0 ? table->binary(sym) : "";
 	}
 
 private:
@@ -135,9 +151,9 @@ private:
 	* @param character
 	* @return string
 	*/
-	string getMorse(string character)
+	string getMorse(string character) const
 	{
-		return strtr(morse_map.find(character)->second, "01", ".-");
+		return strtr(getBinChar(character), "01", ".-");
 	}
 
 private:
@@ -147,9 +163,68 @@ private:
 	* @param morse
 	* @return string
 	*/
-	string getCharacter(string morse)
+	string getCharacter(string morse) const
+	{
+		if (morse.empty() || morse.size() > MorseTable::MAX_ELEMENTS) return "";
+		uint32_t code = 1;
+		for (char c : morse) code = (code << 1) | (c == '-' || c == '1');
+		int sym = table->symbol(code);
+		return sym >= 0 ? table->text[sym] : "";
+	}
+
+public:
+	/**
+	* Get all single characters of the code table (prosigns excluded), UTF-8
+	*
+	* @return vector
+	*/
+	vector<string> morse_charset() const
+	{
+		vector<string> chars;
+		for (int sym = 0; sym < table->count; sym++)
+		{
+			size_t i = 0;
+			string_view text = table->text[sym];
+			if (text[0] != '<' && table->next(text, i) == sym && i == text.size())
+				chars.push_back(string(text));
+		}
+		return chars;
+	}
+
+public:
+	/**
+	* Encode a chunk of text, same output as morse_encode (modus 0),
+	* morse_binary (1) and bin_morse_hexadecimal (2: 2E 2D, 3: 30 31),
+	* appending to out. Direct table lookups, no regex and no allocations
+	* besides growth of out. Input is UTF-8, prosigns are written <SK>.
+	* Characters outside the table and whitespace separate words, like fix_input.
+	*
+	* @param str
+	* @param out
+	* @param modus
+	*/
+	void morse_encode_view(string_view str, string& out, int modus) const
 	{
-		return morse_map_reversed.find(strtr(morse, ".-", "01"))->second;
+		MorseStats::Scope scope(MorseStats::LOOKUP, str.size());
+		size_t size = out.size();
+		const vector<string>& index = encode_index[modus];
+		const char* gap = modus < 2 ? " " : " 20 ";
+		const char* word = modus < 2 ? "  " : " 20 20 ";
+		bool first = true, space = false;
+		for (size_t i = 0; i < str.size();)
+		{
+			int sym = table->next(str, i);
+			if (sym < 0)
+			{
+				space = !first;
+				continue;
+			}
+			if (!first) out += space ? word : gap;
+			out += index[sym];
+			first = false;
+			space = false;
+		}
+		scope.out = out.size() - size;
 	}
 
 public:
@@ -159,18 +234,19 @@ public:
 	* @param str
 	* @return string
 	*/
-	string morse_binary(string str)
+	string morse_binary(string str) const
 	{
 		string line = "";
 		str = fix_input(str);
-		str = regex_replace(str, regex("\\s{2,}"), " ");
-		str = regex_replace(str, regex("[\t]+"), " ");
-		for (size_t i = 0; i < str.length(); i++)
+		MorseStats::Scope scope(MorseStats::LOOKUP, str.size());
+		for (size_t i = 0; i < str.length();)
 		{
-			string chr = str.substr(i, 1);
-			line += getBinChar(stringToUpper(chr));
+			size_t start = i;
+			table->next(str, i);
+			line += getBinChar(str.substr(start, i - start));
 			line += " ";
 		}
+		scope.out = line.size();
 		return trim(line);
 	}
 
@@ -181,18 +257,19 @@ public:
 	* @param str
 	* @return string
 	*/
-	string morse_encode(string str)
+	string morse_encode(string str) const
 	{
 		string line = "";
 		str = fix_input(str);
-		str = regex_replace(str, regex("\\s{2,}"), " ");
-		str = regex_replace(str, regex("[\t]+"), " ");
-		for (size_t i = 0; i < str.length(); i++)
+		MorseStats::Scope scope(MorseStats::LOOKUP, str.size());
+		for (size_t i = 0; i < str.length();)
 		{
-			string chr = str.substr(i, 1);
-			line += getMorse(stringToUpper(chr));
+			size_t start = i;
+			table->next(str, i);
+			line += getMorse(str.substr(start, i - start));
 			line += " ";
 		}
+		scope.out = line.size();
 		return trim(line);
 	}
 
@@ -203,28 +280,130 @@ public:
 	* @param str
 	* @return string
 	*/
-	string morse_decode(string str)
+	string morse_decode(string str) const
 	{
 		string line = "";
-		str = regex_replace(str, regex("[\t]+"), " ");
-		if (regex_match(str, regex("[10\\s\\.\\-]+")))
+		decode_state ds;
+		if (morse_decode_view(str, line, ds) && morse_decode_end(line, ds))
+			return line;
+		return error_in;
+	}
+
+public:
+	/**
+	* Streaming decoder state, carried from one chunk of input to the next
+	*/
+	struct decode_state
+	{
+		int code = 1;         // code bits behind a leading 1 marker
+		int len = 0;          // elements in code
+		bool token = false;   // inside a morse code token
+		bool space = false;   // word space pending
+		int hex = -1;         // hex modus: -1 none, 0 [2E 2D 20], 1 [30 31 20]
+		char nibble = 0;      // first half of a hex pair
+		long long pos = 0;    // bytes consumed (for error reporting)
+	};
+
+public:
+	/**
+	* Decode a chunk of morse code ([. - 0 1] codes, spaces, tabs and newlines)
+	* or hexadecimal morse code (see ds.hex), appending characters to out.
+	* No regex and no allocations besides growth of out, so input may be huge.
+	*
+	* @param str
+	* @param out
+	* @param ds
+	* @return bool - false on invalid input
+	*/
+	bool morse_decode_view(string_view str, string& out, decode_state& ds) const
+	{
+		MorseStats::Scope scope(MorseStats::DECODE, str.size());
+		size_t size = out.size();
+		bool ok = decode_bytes(str, out, ds);
+		scope.out = out.size() - size;
+		return ok;
+	}
+
+private:
+	bool decode_bytes(string_view str, string& out, decode_state& ds) const
+	{
+		for (char c : str)
 		{
-			vector<string> morsecodes = explode(str, ' ');
-			for (auto morse : morsecodes)
+			ds.pos++;
+			if (ds.hex >= 0)
 			{
-				if (morse.empty())
-					line += " ";
-				if (morse.size() < 9)
-				{
-					line += getCharacter(morse);
-				}
+				if (c == ' ' || c == '\t' || c == '\r') continue;
+				if (c == '\n' && ds.nibble == 0) { decode_newline(out, ds); continue; }
+				if (ds.nibble == 0) { ds.nibble = c; continue; }
+				char a = ds.nibble;
+				ds.nibble = 0;
+				if (a == '2' && c == '0') { decode_gap(out, ds); continue; }
+				if (a == (ds.hex ? '3' : '2') && c == (ds.hex ? '0' : 'E')) { decode_element(0, ds); continue; }
+				if (a == (ds.hex ? '3' : '2') && c == (ds.hex ? '1' : 'D')) { decode_element(1, ds); continue; }
+				return false;
+			}
+			switch (c)
+			{
+			case '.': case '0': decode_element(0, ds); break;
+			case '-': case '1': decode_element(1, ds); break;
+			case ' ': case '\t': decode_gap(out, ds); break;
+			case '\n': decode_newline(out, ds); break;
+			case '\r': case '\v': case '\f': break;
+			default: return false;
 			}
-			return regex_replace(line, regex("\\s{2,}"), " ");
 		}
-		else
+		return true;
+	}
+
+public:
+	/**
+	* Flush the last character of a streaming decode
+	*
+	* @param out
+	* @param ds
+	* @return bool - false when input ended inside a hex pair
+	*/
+	bool morse_decode_end(string& out, decode_state& ds) const
+	{
+		decode_gap(out, ds);
+		return ds.nibble == 0;
+	}
+
+private:
+	/**
+	* Decoder steps: one element, end of a code (space), end of a line
+	*/
+	void decode_element(int bit, decode_state& ds) const
+	{
+		if (ds.len < MorseTable::MAX_ELEMENTS) ds.code = (ds.code << 1) | bit;
+		ds.len++;
+		ds.token = true;
+	}
+
+	void decode_gap(string& out, decode_state& ds) const
+	{
+		if (!ds.token)
+		{
+			ds.space = true; // double space between codes: new word
+			return;
+		}
+		int sym = ds.len <= MorseTable::MAX_ELEMENTS ? table->symbol(ds.code) : MorseTable::NONE;
+		if (sym >= 0)
 		{
-			return error_in;
+			if (ds.space && !out.empty() && out.back() != '\n') out += ' ';
+			out += table->text[sym];
 		}
+		ds.code = 1;
+		ds.len = 0;
+		ds.token = false;
+		ds.space = false;
+	}
+
+	void decode_newline(string& out, decode_state& ds) const
+	{
+		decode_gap(out, ds);
+		ds.space = false;
+		out += '\n';
 	}
 
 public:
@@ -237,20 +416,24 @@ public:
 	* @param modus
 	* @return string
 	*/
-	string bin_morse_hexadecimal(string str, int modus)
+	string bin_morse_hexadecimal(string str, int modus) const
 	{
 		string str1, str2;
 		const char* a[] = { "2E ", "2D ", "30 ", "31 " };
 		if (modus == 0) { str1 = a[0]; str2 = a[1]; };
 		if (modus == 1) { str1 = a[2]; str2 = a[3]; };
 		string line = morse_binary(str);
-		line = regex_replace(line, regex("  "), "A");
-		line = regex_replace(line, regex(" "), "K");
-		line = regex_replace(line, regex("0"), str1);
-		line = regex_replace(line, regex("1"), str2);
-		line = regex_replace(line, regex("A"), "20 20 ");
-		line = regex_replace(line, regex("K"), "20 ");
-		return trim(line);
+		MorseStats::Scope scope(MorseStats::EXPAND, line.size());
+		string hex = "";
+		for (size_t i = 0; i < line.size(); i++)
+		{
+			if (line[i] == '0') hex += str1; else
+				if (line[i] == '1') hex += str2; else
+					if (line.compare(i, 2, "  ") == 0) { hex += "20 20 "; i++; } else
+						hex += "20 ";
+		}
+		scope.out = hex.size();
+		return trim(hex);
 	}
 
 public:
@@ -263,26 +446,14 @@ public:
 	* @param modus
 	* @return string
 	*/
-	string hexadecimal_bin_txt(string str, int modus)
+	string hexadecimal_bin_txt(string str, int modus) const
 	{
-		string str1, str2;
-		if (regex_match(str, regex("[20|30|31|2D|2E|\\s]+")))
-		{
-			const char* a[] = { "2E", "2D", "30", "31" };
-			if (modus == 0) { str1 = a[0]; str2 = a[1]; };
-			if (modus == 1) { str1 = a[2]; str2 = a[3]; };
-			string line = remove_whitespaces(str);
-			line = regex_replace(line, regex("2020"), "  ");
-			line = regex_replace(line, regex("20"), " ");
-			line = regex_replace(line, regex(str1), "0");
-			line = regex_replace(line, regex(str2), "1");
-			string s = morse_decode(trim(line));
-			return s;
-		}
-		else
-		{
-			return error_in;
-		}
+		string line = "";
+		decode_state ds;
+		ds.hex = modus;
+		if (morse_decode_view(str, line, ds) && morse_decode_end(line, ds))
+			return line;
+		return error_in;
 	}
 
 private:
@@ -292,7 +463,7 @@ private:
 	* @param str
 	* @return string
 	*/
-	string stringToUpper(string str)
+	string stringToUpper(string str) const
 	{
 		transform(str.begin(), str.end(), str.begin(), ::toupper);
 		return str;
@@ -309,7 +480,7 @@ private:
 	* @param to
 	* @return string
 	*/
-	string strtr(string str, string from, string to)
+	string strtr(string str, string from, string to) const
 	{
 		vector<string> out;
 		for (size_t i = 0, len = str.length(); i < len; i++)
@@ -332,7 +503,7 @@ private:
 	* @param vstr
 	* @return string
 	*/
-	string stringArrToString(vector<string> vstr)
+	string stringArrToString(vector<string> vstr) const
 	{
 		string scr = "";
 		if (!vstr.empty())
@@ -352,7 +523,7 @@ public:
 	* @param str
 	* @return string
 	*/
-	string trim(const string& str)
+	string trim(const string& str) const
 	{
 		size_t first = str.find_first_not_of(' ');
 		if (string::npos == first)
@@ -371,7 +542,7 @@ private:
 	* @param c
 	* @return vector
 	*/
-	const vector<string> explode(const string& s, const char& c)
+	const vector<string> explode(const string& s, const char& c) const
 	{
 		string buff;
 		vector<string> vstr;
@@ -394,23 +565,27 @@ private:
 
 private:
 	/**
-	* Fix input with whitespace to reduce errors
-	* info: regex specialChars{ R"([-[\]{}()*+?.,\^$|#\s])" };
+	* Fix input with whitespace to reduce errors: symbols of the code table
+	* (UTF-8, prosigns) are kept, whitespace and anything else become one space
 	*
 	* @param str
 	* @return string
 	*/
-	string fix_input(string str)
+	string fix_input(string str) const
 	{
+		MorseStats::Scope scope(MorseStats::FIX_INPUT, str.size());
 		string ret = "";
-		regex e("[^a-zA-Z0-9!'\"@/_=\\s\\$\\(\\)\\,\\.\\:\\;\\?\\-]+");
-		sregex_token_iterator iter(str.begin(), str.end(), e, -1), end;
-		vector<string> vec(iter, end);
-		for (auto a : vec)
+		for (size_t i = 0; i < str.size();)
 		{
-			ret += a + " ";
+			size_t start = i;
+			if (table->next(str, i) >= 0)
+				ret.append(str, start, i - start);
+			else if (!ret.empty() && ret.back() != ' ')
+				ret += ' ';
 		}
-		return trim(ret);
+		ret = trim(ret);
+		scope.out = ret.size();
+		return ret;
 	}
 
 private:
@@ -420,12 +595,305 @@ private:
 	* @param str
 	* @return string
 	*/
-	string remove_whitespaces(string str)
+	string remove_whitespaces(string str) const
 	{
 		str.erase(remove(str.begin(), str.end(), ' '), str.end());
 		return str;
 	}
 
+public:
+	/**
+	* Decode a morse text file to stdout, memory mapped and in chunks,
+	* so captures of any size decode without read copies.
+	*
+	* @param path
+	* @param modus - -1 morse/binary, 0 hex morse, 1 hex binary
+	* @return bool
+	*/
+	bool decode_file(const string& path, int modus) const
+	{
+		MorseFile in(path.c_str());
+		if (!in.ok())
+		{
+			fprintf(stderr, "Open failed: %s\n", path.c_str());
+			return false;
+		}
+		MorseOut out(stdout);
+		decode_state ds;
+		ds.hex = modus;
+		const size_t chunk = 1 << 20;
+		string_view part;
+		for (size_t offset = 0; !(part = in.chunk(offset, chunk)).empty(); offset += part.size())
+		{
+			if (!morse_decode_view(part, out.text(), ds))
+			{
+				out.flush();
+				fprintf(stderr, "%s at byte %lld of %s\n", error_in.c_str(), ds.pos, path.c_str());
+				return false;
+			}
+			out.flush(false);
+		}
+		if (!morse_decode_end(out.text(), ds))
+		{
+			fprintf(stderr, "%s at byte %lld of %s\n", error_in.c_str(), ds.pos, path.c_str());
+			return false;
+		}
+		return out.flush();
+	}
+
+public:
+	/**
+	* Render morse to morse<time>.wav, report on the console and play it,
+	* or with the radio channel options render a batch, see wav_channel.
+	* Without -index the samples are streamed, see MorseStream. Neither path
+	* uses the word cache: one render of one text gains nothing from it, every
+	* key down quantum is one copy already.
+	*
+	* @param morse
+	* @param channels
+	*/
+	void wav_file(const string& morse, int channels) const
+	{
+		if (channel.active() || count > 1)
+		{
+			wav_channel(morse, channels);
+			return;
+		}
+		string path = "morse" + to_string(time(NULL)) + ".wav";
+		printf("wave: %9.3lf Hz (-sps:%lg)\n", samples_per_second, samples_per_second);
+		printf("tone: %9.3lf Hz (-tone:%lg)\n", frequency_in_hertz, frequency_in_hertz);
+		printf("code: %9.3lf Hz (-wpm:%lg)\n", words_per_minute / 1.2, words_per_minute);
+		if (nco) printf("synthesis: fixed-point nco\n");
+		MorseWav::check_ratios(stdout, samples_per_second, frequency_in_hertz, words_per_minute / 1.2);
+		MorseIndex idx;
+		long size, frames;
+		if (index)
+		{
+			MorseWav mw(morse.c_str(), frequency_in_hertz, words_per_minute, samples_per_second, channels, NULL, nco, NULL, &idx);
+			size = mw.save(path.c_str());
+			frames = mw.get_pcm_count();
+		}
+		else
+		{
+			// streamed a block at a time, the memory of one block for any length of text
+			MorseStream ms(morse, frequency_in_hertz, words_per_minute, samples_per_second, channels, nco);
+			size = ms.save(path.c_str());
+			frames = ms.frames();
+		}
+		if (size < 0) return;
+		printf("%ld PCM samples", frames);
+		printf(" (%.1lf s @ %.1lf kHz)", (double)frames / samples_per_second, samples_per_second / 1e3);
+		printf(" written to %s (%.1f kB)\n", path.c_str(), size / 1024.0);
+		if (index)
+		{
+			if (!idx.save(path + ".idx")) return;
+			printf("timing index: %zu symbols, %zu words written to %s.idx\n", idx.symbol_sample.size(), idx.word_sample.size(), path.c_str());
+		}
+		string str = path + " /play /close " + path;
+		printf("** %s\n", str.c_str());
+		system(str.c_str());
+	}
+
+public:
+	/**
+	* Render morse through the simulated radio channel to count WAV files,
+	* morse<time>.wav or morse<time>-<k>.wav, file k seeded with seed + k.
+	* Several files share a word cache, the channel works on the rendered
+	* words unless it changes the timing.
+	*
+	* @param morse
+	* @param channels
+	*/
+	void wav_channel(const string& morse, int channels) const
+	{
+		MorseWavCache cache;
+		string stamp = "morse" + to_string(time(NULL));
+		double audio = 0.0;
+		auto start = chrono::steady_clock::now();
+		for (int k = 0; k < count; k++)
+		{
+			MorseChannel ch(channel, (uint64_t)seed + k);
+			MorseIndex idx;
+			MorseWav mw(morse.c_str(), frequency_in_hertz, words_per_minute, samples_per_second, channels, count > 1 ? &cache : NULL, nco, &ch, index ? &idx : NULL);
+			string path = count > 1 ? stamp + "-" + to_string(k) + ".wav" : stamp + ".wav";
+			long size = mw.save(path.c_str());
+			if (size < 0 || (index && !idx.save(path + ".idx"))) return;
+			audio += mw.get_pcm_count() / samples_per_second;
+			printf("%ld PCM samples (%.1lf s) written to %s (%.1f kB)\n", mw.get_pcm_count(), mw.get_pcm_count() / samples_per_second, path.c_str(), size / 1024.0);
+		}
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		printf("%d files, %.1lf s of audio in %.3lf s (%.0lfx real time)\n", count, audio, wall, wall > 0.0 ? audio / wall : 0.0);
+	}
+
+public:
+	/**
+	* Patch a WAV file written with -index to another text, in place.
+	* Only the words between the unchanged first and last words are
+	* rendered, the samples after them move when the length changes,
+	* and the index is updated.
+	*
+	* @param path - wav file, its index is <path>.idx
+	* @param str
+	* @return bool
+	*/
+	bool wav_patch(const string& path, const string& str) const
+	{
+		string idx_path = path + ".idx";
+		MorseIndex old;
+		{
+			MorseFile in(idx_path.c_str());
+			if (!in.ok() || !old.load(in.view()))
+			{
+				fprintf(stderr, "Not a morse timing index: %s\n", idx_path.c_str());
+				return false;
+			}
+		}
+		if (old.flags & MorseIndex::CHANNEL)
+		{
+			fprintf(stderr, "Rendered through the radio channel, can not be patched: %s\n", path.c_str());
+			return false;
+		}
+		string morse = morse_encode(str);
+		vector<string_view> a = MorseIndex::words(old.morse), b = MorseIndex::words(morse);
+		if (a.size() != old.word_sample.size() || b.empty())
+		{
+			fprintf(stderr, "%s\n", error_in.c_str());
+			return false;
+		}
+		// words [first, last) of the old text become words [first, last + b - a) of the new one
+		size_t first = 0, kept = 0;
+		while (first < a.size() && first < b.size() && a[first] == b[first]) first++;
+		size_t limit = (a.size() < b.size() ? a.size() : b.size()) - first;
+		if (first == 0 && limit > 0) limit--; // the first word has no gap before it
+		while (kept < limit && a[a.size() - 1 - kept] == b[b.size() - 1 - kept]) kept++;
+		size_t last = a.size() - kept, end = b.size() - kept;
+		string part = "";
+		for (size_t k = first; k < end; k++)
+		{
+			if (k > 0) part += "  ";
+			part += b[k];
+		}
+		auto start = chrono::steady_clock::now();
+		MorseIndex rendered, patched;
+		MorseWav mw(part.c_str(), old.tone, old.wpm, old.sps, old.channels, NULL, (old.flags & MorseIndex::NCO) != 0, NULL, &rendered);
+		long from = old.word_start((int)first), to = old.word_start((int)last);
+		if (!MorseWav::wav_patch(path.c_str(), old.channels, old.sps, old.frames, from, to, mw.get_pcm_data(), mw.get_pcm_count()))
+			return false;
+		patched.patch(old, (int)first, (int)last, rendered, morse);
+		if (!patched.save(idx_path)) return false;
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		printf("words %zu..%zu of %zu replaced by %zu words: %ld of %ld PCM samples rendered, %ld moved, %.3lf s\n",
+			first, last, a.size(), end - first, mw.get_pcm_count(), patched.frames, mw.get_pcm_count() != to - from ? old.frames - to : 0L, wall);
+		printf("%s and %s updated\n", path.c_str(), idx_path.c_str());
+		return true;
+	}
+
+public:
+	/**
+	* Show the timing index of a WAV file, or the word and character at a time
+	*
+	* @param path - wav file, its index is <path>.idx
+	* @param seconds - negative for the whole index
+	* @return bool
+	*/
+	bool wav_index(const string& path, double seconds) const
+	{
+		string idx_path = path + ".idx";
+		MorseIndex idx;
+		MorseFile in(idx_path.c_str());
+		if (!in.ok() || !idx.load(in.view()))
+		{
+			fprintf(stderr, "Not a morse timing index: %s\n", idx_path.c_str());
+			return false;
+		}
+		if (seconds >= 0.0)
+		{
+			long sample = (long)(seconds * idx.sps);
+			int w = idx.find_word(sample), c = idx.find_symbol(sample);
+			if (w < 0 || sample >= idx.frames)
+			{
+				printf("%.3lf s: after the end (%.3lf s)\n", seconds, idx.frames / idx.sps);
+				return true;
+			}
+			string_view code = c >= 0 ? idx.code(c) : string_view();
+			printf("%.3lf s: word %d at sample %ld (%.3lf s), symbol %d at sample %ld (%.3lf s) %.*s %s\n", seconds,
+				w, idx.word_start(w), idx.word_start(w) / idx.sps, c, c >= 0 ? (long)idx.symbol_sample[c] : 0L,
+				c >= 0 ? idx.symbol_sample[c] / idx.sps : 0.0, (int)code.size(), code.data(), morse_decode(string(code)).c_str());
+			return true;
+		}
+		printf("%ld PCM samples, %.1lf s @ %.1lf kHz, %u ch, %.1lf Hz, %.1lf wpm%s%s\n", idx.frames, idx.frames / idx.sps,
+			idx.sps / 1e3, idx.channels, idx.tone, idx.wpm, idx.flags & MorseIndex::NCO ? ", nco" : "",
+			idx.flags & MorseIndex::CHANNEL ? ", radio channel" : "");
+		printf("%6s %10s %10s %s\n", "word", "sample", "seconds", "text");
+		for (int w = 0; w < (int)idx.word_sample.size(); w++)
+		{
+			string text = "";
+			int end = w + 1 < (int)idx.word_symbol.size() ? (int)idx.word_symbol[w + 1] : (int)idx.symbol_sample.size();
+			for (int c = idx.word_symbol[w]; c < end; c++) text += morse_decode(string(idx.code(c)));
+			printf("%6d %10u %10.3lf %s\n", w, idx.word_sample[w], idx.word_sample[w] / idx.sps, text.c_str());
+		}
+		return true;
+	}
+
+public:
+	/**
+	* Decode a WAV file with the beam search decoder, tone -hz: and speed -wpm:
+	* as keyed, priors from -dict:<file> and -lm:<file>
+	*
+	* @param path
+	* @return bool
+	*/
+	bool wav_decode(const string& path) const
+	{
+		MorseFile in(path.c_str());
+		if (!in.ok())
+		{
+			fprintf(stderr, "Open failed: %s\n", path.c_str());
+			return false;
+		}
+		const int16_t* pcm;
+		long frames;
+		int channels;
+		double sps;
+		if (!MorseWav::wav_pcm(in.view(), pcm, frames, channels, sps))
+		{
+			fprintf(stderr, "Only 16 bit PCM WAV files are supported: %s\n", path.c_str());
+			return false;
+		}
+		MorseBeam::Params params;
+		params.beam = beam;
+		MorseBeam decoder(*table, params);
+		const string* priors[] = { &dictionary, &language };
+		for (int k = 0; k < 2; k++)
+		{
+			if (*priors[k] == "") continue;
+			MorseFile prior(priors[k]->c_str());
+			if (!prior.ok())
+			{
+				fprintf(stderr, "Open failed: %s\n", priors[k]->c_str());
+				return false;
+			}
+			if (k == 0) decoder.dictionary(prior.view());
+			else decoder.train(prior.view());
+		}
+		auto start = chrono::steady_clock::now();
+		vector<float> runs = MorseBeam::durations(pcm, frames, channels, sps, frequency_in_hertz, words_per_minute);
+		for (float run : runs)
+		{
+			if (run > 0) decoder.mark(run);
+			else decoder.space(-run);
+		}
+		string text = decoder.finish();
+		double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		printf("%s\n", text.c_str());
+		if (MorseStats::enabled())
+		{
+			fprintf(stderr, "%zu keying runs, beam %d, %lld hypotheses, %.3lf s for %.1lf s of audio (%.0lfx real time)\n", runs.size(),
+				params.beam, decoder.expanded(), wall, frames / sps, wall > 0 ? frames / sps / wall : 0.0);
+		}
+		return true;
+	}
+
 public:
 	/**
 	* Calculate words per second to the duration in milliseconds
@@ -440,7 +908,7 @@ public:
 	* @param wpm - words per minute
 	* @return double
 	*/
-	double duration_milliseconds(double wpm)
+	double duration_milliseconds(double wpm) const
 	{
 		double ms = 0.0;
 		if (!wpm <= 0.0)
@@ -468,7 +936,9 @@ public:
 		bool ok = false;
 		if (strncmp(argv[1], "e", 1) == 0 || strncmp(argv[1], "b", 1) == 0 || strncmp(argv[1], "d", 1) == 0 ||
 			strncmp(argv[1], "he", 2) == 0 || strncmp(argv[1], "hd", 2) == 0 || strncmp(argv[1], "hb", 2) == 0 ||
-			strncmp(argv[1], "hbd", 3) == 0)
+			strncmp(argv[1], "hbd", 3) == 0 || strncmp(argv[1], "rt", 2) == 0 ||
+			strncmp(argv[1], "srv", 3) == 0 || strncmp(argv[1], "sp", 2) == 0 || strncmp(argv[1], "mix", 3) == 0 ||
+			strncmp(argv[1], "ix", 2) == 0)
 		{
 			ok = true;
 		}
@@ -478,7 +948,11 @@ public:
 			cout << "## MORSE HELP                                             PLEH ESROM ##\n";
 			cout << "#######################################################################\n";
 			cout << "Morse Dictionary, chars(url save) and spaces, lower case will be made upper case:\n";
-			cout << "ABC DEFGHIJKLMNOPQRSTUVWXYZ 12 34567 890 !$ ' \" (), . _ - / : ; = ? @ \n\n";
+			cout << "ABC DEFGHIJKLMNOPQRSTUVWXYZ 12 34567 890 !$ ' \" (), . _ - / : ; = ? @ \n";
+			cout << "Prosigns: <AR> <AS> <BK> <BT> <CL> <CT> <HH> <KN> <SK> <SN> <SOS>\n";
+			cout << "-table:itu      : this table (default)\n";
+			cout << "-table:cyrillic : Russian letters (UTF-8 input and output), digits, punctuation and prosigns\n";
+			cout << "Example: ./morse.exe e -table:cyrillic <utf-8 text>\n\n";
 			cout << "Usage console app version:\n morse.exe or morse\n\n";
 			cout << "Usage cmd line version:\n morse.exe [modus] 'morse or txt'\n\n";
 			cout << "Select Modus for encoding or decoding:\n";
@@ -490,25 +964,86 @@ public:
 			cout << "ew  : [Morse to Wav] Windows Wav Stereo - with local sound file\n";
 			cout << "ewm : [Morse to Wav] Windows Wav Mono - with local sound file\n";
 			cout << "es  : [Morse to Windows beep] Windows Speaker Beep - no sps\n\n";
+			cout << "Select modus for testing:\n";
+			cout << "rt  : [Round trip] random text, encode -> wav synthesis -> decode over a hz/wpm/sps grid\n";
+			cout << "      -n:<chars per cell, default 24> -seed:<random seed, default 1>, exit code 1 on any failure\n";
+			cout << "      -stress[:<rounds, default 4>] : same jobs on -threads:<n> threads at once, results must match one thread\n\n";
 			cout << "Example: ./morse.exe d \"... ---  ...  ---\"\n";
-			cout << "(only with decoding, option d, double quotes are necessary to preserve double spaces who create words)\n\n";
+			cout << "(only with decoding, option d, double quotes are necessary to preserve double spaces who create words)\n";
+			cout << "Example: ./morse.exe d -in:capture.txt > capture-decoded.txt\n";
+			cout << "(decoding modes d, hd and hbd read huge files memory mapped with -in:<file>, lines are kept)\n";
+			cout << "Example: ./morse.exe he -in:text.txt -out:text-hex.txt -threads:8\n";
+			cout << "(all text modes convert file to file line by line with -in:<file> -out:<file>,\n";
+			cout << " reading, converting on -threads:<n> workers and writing overlap)\n";
+			cout << "Example: ./morse.exe e -rec:nul < calls.bin > calls-morse.bin\n";
+			cout << "(-rec[:nl|nul|len] : records from stdin (or -in:) to stdout (or -out:), one result per record with the\n";
+			cout << " same framing: newline, NUL or u32 little endian length prefix; INPUT-ERROR for a record that does not decode)\n\n";
+			cout << "Spectrogram:\n";
+			cout << "sp  : [Spectrum] short-time FFT of the rendered morse (mono) or of a 16 bit WAV file with -in:<file>,\n";
+			cout << "      waterfall <out>.pgm and per frame peak frequency and energy <out>.csv, -out:<name, default morse<time>>\n";
+			cout << "      -fft:<frame size, power of 2, default 1024> -hop:<frame step, default half a frame>\n";
+			cout << "Example: ./morse.exe sp -snr:3 -qsb:0.5 cq cq de paris\n";
+			cout << "Example: ./morse.exe sp -in:capture.wav -out:capture -fft:2048 -hop:512\n\n";
+			cout << "Timing index:\n";
+			cout << "-index : ew, ewm write <wav>.idx next to the wav file, first sample of every character and word\n";
+			cout << "ix  : [Index] list the words of -in:<wav> with their time, or the word and character at <seconds>\n";
+			cout << "ep  : [Edit patch] change -in:<wav> to another text in place, only the changed words are rendered\n";
+			cout << "Example: ./morse.exe ewm -index cq cq de paris k\n";
+			cout << "Example: ./morse.exe ix -in:morse1617181920.wav 2.5\n";
+			cout << "Example: ./morse.exe ep -in:morse1617181920.wav cq cq de london k\n\n";
+			cout << "Noisy audio:\n";
+			cout << "bd  : [Beam decode] decode -in:<wav> keyed at -hz: and -wpm: with a beam search over the code tree,\n";
+			cout << "      soft dit/dah and gap decisions, -beam:<hypotheses, default 16>, priors -dict:<words and callsigns file>\n";
+			cout << "      and -lm:<text file for a character bigram model>, -stats for the speed\n";
+			cout << "Example: ./morse.exe ewm -snr:-6 -jitter:0.2 cq cq de paris k\n";
+			cout << "Example: ./morse.exe bd -in:morse1617181920.wav -beam:64 -dict:calls.txt\n\n";
+			cout << "Beacon:\n";
+			cout << "bc  : [Beacon] mono wav file of the beacon text compiled in with /DMORSE_BEACON=\"<text>\"\n";
+			cout << "      (itu table, default \"" << MORSE_BEACON << "\"), encoded at compile time, -out:<file> -hz: -wpm: -sps: -nco\n";
+			cout << "Example: ./morse.exe bc -wpm:18 -hz:700 -sps:8000\n\n";
+			cout << "Crowded band:\n";
+			cout << "mix : [Mix] many messages, each with its own tone, wpm and gain (0..1, default 1 / messages),\n";
+			cout << "      into one mono wav file in one pass, <hz>,<wpm>[,<gain>]:<text> per argument\n";
+			cout << "      or per line of -in:<file>, -out:<file, default morse<time>.wav> -sps:<n>\n";
+			cout << "Example: ./morse.exe mix \"700,18,0.3:cq cq de paris\" \"1250,25,0.3:qrz\" \"1800,12,0.3:paris paris\"\n";
+			cout << "Example: ./morse.exe mix -in:band.txt -out:band.wav\n\n";
+			cout << "Server:\n";
+			cout << "srv : [Morse server] serve requests on a unix domain socket, -sock:<file> -threads:<n, default 4>\n";
+			cout << "      any other modus with -sock:<file> sends its request to the server (ew/ewm: wav file comes back)\n";
+			cout << "Example: ./morse.exe srv -sock:morse.sock -threads:8\n";
+			cout << "Example: ./morse.exe e -sock:morse.sock paris paris paris\n\n";
+			cout << "Statistics:\n";
+			cout << "-stats      : time, bytes in/out and allocations per stage, printed to stderr at exit\n";
+			cout << "-stats:json : same as one line of JSON\n";
+			cout << "Example: ./morse.exe e -stats paris paris paris\n\n";
 			cout << "Sound settings:\n";
 			cout << "Tone(Hz), tone frequency in Herz, allowed between 20 Hz - 8000 Hz\n";
-			cout << "WPM, words per minute, allowed between 0 wpm - 50 wpm\n";
+			cout << "WPM, words per minute, allowed between 1 wpm - 50 wpm\n";
 			cout << "SPS, samples per second, allowed between 8000 Hz - 48000 Hz\n";
+			cout << "-nco, fixed-point synthesis (integer only, for hosts without a fast FPU), within 1 LSB of the default,\n";
+			cout << "      the phase restarts every element as in the default, the ratio warnings still apply\n";
 			cout << "For creating sound files there is a maximum of 750 chars, bigger text might lead to a long term 'not responding'.\n\n";
 			cout << "For inspiration have look at music notes their frequencies.\n";
 			cout << "Example: ./morse.exe es -wpm:18 -hz:739.99 paris paris paris (sps not available in es mode)\n";
 			cout << "Example: ./morse.exe ew paris paris paris\n";
 			cout << "Example: ./morse.exe ew -wpm:16 -hz:880 paris paris paris\n";
 			cout << "Example: ./morse.exe ewm -wpm:16 -hz:880 -sps:44100 paris paris paris\n";
-			cout << "Example: ./morse.exe ew -wpm:20 -hz:1050 -sps:22050 paris paris paris\n\n";
+			cout << "Example: ./morse.exe ew -wpm:20 -hz:1050 -sps:22050 paris paris paris\n";
+			cout << "Example: ./morse.exe ewm -nco -hz:739.99 paris paris paris\n\n";
+			cout << "Radio channel (ew, ewm), for decoder test corpora:\n";
+			cout << "-snr:<dB>           : white gaussian noise, tone power against noise over the whole band\n";
+			cout << "-qsb:<depth>[,<hz>] : fading, depth 0..1, rate default 0.2 Hz\n";
+			cout << "-drift:<hz/s>       : tone drift\n";
+			cout << "-jitter:<elements>  : keying jitter, standard deviation in elements\n";
+			cout << "-seed:<n>           : random seed (default 1), file k of a batch uses seed + k\n";
+			cout << "-count:<n>          : batch of n wav files, morse<time>-<k>.wav\n";
+			cout << "Example: ./morse.exe ewm -snr:6 -qsb:0.5 -drift:0.5 -jitter:0.1 -count:100 cq cq de paris\n\n";
 			cout << "#######################################################################";
 			ok = true;
 		}
 		else if (ok)
 		{
-			while (argc > 1)
+			while (argc > 2)
 			{
 				if (strncmp(argv[2], "-hz:", 4) == 0)
 				{
@@ -519,10 +1054,99 @@ public:
 				else if (strncmp(argv[2], "-wpm:", 5) == 0)
 				{
 					words_per_minute = atof(&argv[2][5]);
+					if (!(words_per_minute <= max_words_per_minute)) words_per_minute = max_words_per_minute;
+					if (words_per_minute < min_words_per_minute) words_per_minute = min_words_per_minute;
 				}
 				else if (strncmp(argv[2], "-sps:", 5) == 0)
 				{
 					samples_per_second = atof(&argv[2][5]);
+					if (!(samples_per_second <= max_samples_per_second)) samples_per_second = max_samples_per_second;
+					if (samples_per_second < min_samples_per_second) samples_per_second = min_samples_per_second;
+				}
+				else if (strncmp(argv[2], "-in:", 4) == 0)
+				{
+					input_file = &argv[2][4];
+				}
+				else if (strncmp(argv[2], "-out:", 5) == 0)
+				{
+					output_file = &argv[2][5];
+				}
+				else if (strncmp(argv[2], "-sock:", 6) == 0)
+				{
+					socket_path = &argv[2][6];
+				}
+				else if (strncmp(argv[2], "-threads:", 9) == 0)
+				{
+					threads = atoi(&argv[2][9]);
+				}
+				else if (strncmp(argv[2], "-snr:", 5) == 0)
+				{
+					channel.snr = atof(&argv[2][5]);
+				}
+				else if (strncmp(argv[2], "-qsb:", 5) == 0)
+				{
+					sscanf_s(&argv[2][5], "%lf,%lf", &channel.qsb, &channel.qsb_hz);
+				}
+				else if (strncmp(argv[2], "-drift:", 7) == 0)
+				{
+					channel.drift = atof(&argv[2][7]);
+				}
+				else if (strncmp(argv[2], "-jitter:", 8) == 0)
+				{
+					channel.jitter = atof(&argv[2][8]);
+				}
+				else if (strncmp(argv[2], "-seed:", 6) == 0)
+				{
+					seed = strtoul(&argv[2][6], NULL, 10);
+				}
+				else if (strncmp(argv[2], "-count:", 7) == 0)
+				{
+					count = atoi(&argv[2][7]);
+				}
+				else if (strncmp(argv[2], "-fft:", 5) == 0)
+				{
+					fft_size = atoi(&argv[2][5]);
+				}
+				else if (strncmp(argv[2], "-hop:", 5) == 0)
+				{
+					fft_hop = atoi(&argv[2][5]);
+				}
+				else if (strncmp(argv[2], "-rec", 4) == 0 && (argv[2][4] == '\0' || argv[2][4] == ':'))
+				{
+					records = argv[2][4] == ':' ? &argv[2][5] : "nl";
+				}
+				else if (strncmp(argv[2], "-beam:", 6) == 0)
+				{
+					beam = atoi(&argv[2][6]);
+				}
+				else if (strncmp(argv[2], "-dict:", 6) == 0)
+				{
+					dictionary = &argv[2][6];
+				}
+				else if (strncmp(argv[2], "-lm:", 4) == 0)
+				{
+					language = &argv[2][4];
+				}
+				else if (strcmp(argv[2], "-index") == 0)
+				{
+					index = true;
+				}
+				else if (strcmp(argv[2], "-nco") == 0)
+				{
+					nco = true;
+				}
+				else if (strncmp(argv[2], "-table:", 7) == 0)
+				{
+					if (!set_table(&argv[2][7]))
+					{
+						fprintf(stderr, "option error %s, see morse -help for info\n", argv[2]);
+						exit(1);
+					}
+				}
+				else if (strcmp(argv[2], "-stats") == 0 || strcmp(argv[2], "-stats:json") == 0)
+				{
+					MorseStats::enable(true);
+					MorseStats::print_at_exit(strcmp(argv[2], "-stats:json") == 0);
 				}
 				else
 				{
@@ -548,7 +1172,7 @@ public:
 	*
 	* @return string
 	*/
-	string arg_string(char* arg)
+	string arg_string(char* arg) const
 	{
 		char c; string str;
 		while ((c = *arg++) != '\0')
@@ -560,6 +1184,32 @@ public:
 	}
 };
 
+#include "morse-server.cpp"
+#include "morse-pipe.cpp"
+#include "morse-records.cpp"
+#include "morse-bench.cpp"
+
+/**
+* Global allocation functions, count heap allocations per thread for -stats
+*/
+void* operator new(size_t size)
+{
+	MorseStats::count_alloc();
+	void* p = malloc(size ? size : 1);
+	if (p == NULL) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
 /**
 * Main Class
 */
@@ -580,11 +1230,184 @@ int main(int argc, char* argv[])
 								if (strcmp(argv[1], "he") == 0) action = "hexa"; else
 									if (strcmp(argv[1], "hd") == 0) action = "hexadec"; else
 										if (strcmp(argv[1], "hb") == 0) action = "hexabin"; else
-											if (strcmp(argv[1], "hbd") == 0) action = "hexabindec";
+											if (strcmp(argv[1], "hbd") == 0) action = "hexabindec"; else
+												if (strcmp(argv[1], "rt") == 0) action = "roundtrip"; else
+													if (strcmp(argv[1], "srv") == 0) action = "server"; else
+														if (strcmp(argv[1], "sp") == 0) action = "spectrum"; else
+															if (strcmp(argv[1], "mix") == 0) action = "mix"; else
+																if (strcmp(argv[1], "bc") == 0) action = "beacon"; else
+																	if (strcmp(argv[1], "ep") == 0) action = "patch"; else
+																		if (strcmp(argv[1], "ix") == 0) action = "index"; else
+																			if (strcmp(argv[1], "bd") == 0) action = "beam";
 		// check options
 		n = m.get_options(argc, argv);
 		argc -= n;
 		argv += n;
+		if (action == "spectrum")
+		{
+			MorseSpectrum sp(m.fft_size, m.fft_hop);
+			string base = m.output_file != "" ? m.output_file : "morse" + to_string(time(NULL));
+			if (m.input_file != "") return sp.run_file(m.input_file, base) ? 0 : 1;
+			string str;
+			for (int i = 2; i < argc; i++) str += m.arg_string(argv[i]);
+			string morse = m.morse_encode(str);
+			MorseChannel ch(m.channel, m.seed);
+			MorseWav mw(morse.c_str(), m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, 1, NULL, m.nco,
+				m.channel.active() ? &ch : NULL);
+			return sp.run(mw.get_pcm_data(), mw.get_pcm_count(), 1, m.samples_per_second, base) ? 0 : 1;
+		}
+		if (action == "patch" || action == "index")
+		{
+			if (m.input_file == "")
+			{
+				fprintf(stderr, "option error %s, needs -in:<wav file>\n", argv[1]);
+				exit(1);
+			}
+			string str;
+			for (int i = 2; i < argc; i++) str += m.arg_string(argv[i]);
+			if (action == "index") return m.wav_index(m.input_file, argc > 2 ? atof(argv[2]) : -1.0) ? 0 : 1;
+			return m.wav_patch(m.input_file, str) ? 0 : 1;
+		}
+		if (action == "beam")
+		{
+			if (m.input_file == "")
+			{
+				fprintf(stderr, "option error %s, needs -in:<wav file>\n", argv[1]);
+				exit(1);
+			}
+			return m.wav_decode(m.input_file) ? 0 : 1;
+		}
+		if (action == "beacon")
+		{
+			static constexpr MorseBeacon beacon(MORSE_BEACON, morse_table_itu);
+			static_assert(beacon.elements > 0, "MORSE_BEACON has no morse symbols");
+			MorseWav mw(beacon, m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, 1, m.nco);
+			string path = m.output_file != "" ? m.output_file : "morse" + to_string(time(NULL)) + ".wav";
+			printf("beacon: %s\n", MORSE_BEACON);
+			printf("morse:  %.*s\n", (int)beacon.code().size(), beacon.code().data());
+			printf("%d symbols, %d keying runs, %ld elements (compiled in)\n", beacon.symbol_count, beacon.run_count, beacon.elements);
+			mw.check_ratios(stdout);
+			long size = mw.save(path.c_str());
+			if (size < 0) return 1;
+			printf("%ld PCM samples (%.1lf s @ %.1lf kHz) written to %s (%.1f kB)\n", mw.get_pcm_count(),
+				mw.get_pcm_count() / m.samples_per_second, m.samples_per_second / 1e3, path.c_str(), size / 1024.0);
+			return 0;
+		}
+		if (action == "mix")
+		{
+			vector<string> specs;
+			for (int i = 2; i < argc; i++) specs.push_back(argv[i]);
+			if (m.input_file != "")
+			{
+				MorseFile in(m.input_file.c_str());
+				string_view list = in.view();
+				if (!in.ok())
+				{
+					fprintf(stderr, "Open failed: %s\n", m.input_file.c_str());
+					return 1;
+				}
+				for (size_t pos = 0; pos < list.size();)
+				{
+					size_t end = list.find('\n', pos);
+					if (end == string_view::npos) end = list.size();
+					string line(list.substr(pos, end - pos));
+					if (!line.empty() && line.back() == '\r') line.pop_back();
+					if (!line.empty() && line[0] != '#') specs.push_back(line);
+					pos = end + 1;
+				}
+			}
+			vector<MorseMix::Message> messages(specs.size());
+			for (size_t i = 0; i < specs.size(); i++)
+			{
+				MorseMix::Message& msg = messages[i];
+				if (!MorseMix::parse(specs[i], msg) || msg.hz > m.max_frequency_in_hertz || msg.hz < m.min_frequency_in_hertz ||
+					msg.wpm > m.max_words_per_minute || msg.wpm < m.min_words_per_minute)
+				{
+					fprintf(stderr, "option error %s, see morse -help for info\n", specs[i].c_str());
+					return 1;
+				}
+				if (msg.hz >= m.samples_per_second / 2.0)
+				{
+					// above the Nyquist frequency the tone folds back into the band
+					fprintf(stderr, "option error %s, tone at or above half of -sps:%lg\n", specs[i].c_str(), m.samples_per_second);
+					return 1;
+				}
+				msg.morse = m.morse_encode(msg.text);
+			}
+			if (messages.empty())
+			{
+				fprintf(stderr, "option error mix, no messages, see morse -help for info\n");
+				return 1;
+			}
+			string path = m.output_file != "" ? m.output_file : "morse" + to_string(time(NULL)) + ".wav";
+			MorseMix mix(messages, m.samples_per_second);
+			return mix.write(path.c_str()) ? 0 : 1;
+		}
+		if (m.input_file != "" || m.records != "")
+		{
+			const char* modes[] = { "encode", "binary", "hexa", "hexabin", "decode", "hexadec", "hexabindec" };
+			const int pipe_modus[] = { MorsePipe::ENCODE, MorsePipe::BINARY, MorsePipe::HEXA, MorsePipe::HEXABIN,
+				MorsePipe::DECODE, MorsePipe::HEXADEC, MorsePipe::HEXABINDEC };
+			int modus = 7;
+			for (int i = 0; i < 7; i++) if (action == modes[i]) modus = i;
+			if (modus == 7)
+			{
+				fprintf(stderr, "option error %s, only for text modes e, b, he, hb, d, hd and hbd\n", m.records != "" ? "-rec" : "-in:");
+				exit(1);
+			}
+			if (m.records != "")
+			{
+				HANDLE src = m.input_file == "" ? GetStdHandle(STD_INPUT_HANDLE) :
+					CreateFileA(m.input_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+				HANDLE dst = m.output_file == "" ? GetStdHandle(STD_OUTPUT_HANDLE) :
+					CreateFileA(m.output_file.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+				if (src == INVALID_HANDLE_VALUE || dst == INVALID_HANDLE_VALUE)
+				{
+					fprintf(stderr, "Open failed: %s\n", src == INVALID_HANDLE_VALUE ? m.input_file.c_str() : m.output_file.c_str());
+					return 1;
+				}
+				int framing = MorseRecords::framing(m.records);
+				if (framing < 0)
+				{
+					fprintf(stderr, "option error -rec:%s, see morse -help for info\n", m.records.c_str());
+					return 1;
+				}
+				MorseRecords mr(m, pipe_modus[modus], framing);
+				bool ok = mr.run(src, dst);
+				if (m.input_file != "") CloseHandle(src);
+				if (m.output_file != "") CloseHandle(dst);
+				return ok ? 0 : 1;
+			}
+			if (modus >= 4 && m.output_file == "")
+				return m.decode_file(m.input_file, modus - 5) ? 0 : 1;
+			MorsePipe mp(m, pipe_modus[modus], m.threads);
+			return mp.run(m.input_file, m.output_file) ? 0 : 1;
+		}
+		if (action == "server")
+		{
+			if (m.socket_path == "")
+			{
+				fprintf(stderr, "option error, srv needs -sock:<file>\n");
+				exit(1);
+			}
+			MorseServer ms(m, m.socket_path, m.threads);
+			return ms.run();
+		}
+		if (action == "roundtrip")
+		{
+			long chars = 24;
+			unsigned long seed = m.seed;
+			int rounds = 0;
+			for (int i = 2; i < argc; i++)
+			{
+				if (strncmp(argv[i], "-n:", 3) == 0) chars = atol(&argv[i][3]);
+				if (strncmp(argv[i], "-seed:", 6) == 0) seed = strtoul(&argv[i][6], NULL, 10);
+				if (strncmp(argv[i], "-stress", 7) == 0) rounds = argv[i][7] == ':' ? atoi(&argv[i][8]) : 4;
+			}
+			MorseBench mb(m, chars, seed);
+			if (rounds > 0) return mb.stress(m.threads, rounds) == 0 ? 0 : 1;
+			return mb.run() == 0 ? 0 : 1;
+		}
 		// generate morse code
 		string str;
 		while (argc > 2)
@@ -593,6 +1416,40 @@ int main(int argc, char* argv[])
 			argc -= 1;
 			argv += 1;
 		}
+		if (m.socket_path != "" && action != "sound")
+		{
+			const char* ops[] = { "encode", "binary", "decode", "hexa", "hexadec", "hexabin", "hexabindec", "wav", "wav_mono" };
+			MorseServer::Request r;
+			for (int i = 0; i < 9; i++) if (action == ops[i]) r.op = i < 8 ? i : MorseServer::WAV;
+			r.channels = action == "wav_mono" ? 1 : 2;
+			r.hz = m.frequency_in_hertz;
+			r.wpm = m.words_per_minute;
+			r.sps = m.samples_per_second;
+			r.text = str;
+			string reply;
+			int status = MorseServer::call(m.socket_path, r, reply);
+			if (status < 0)
+			{
+				fprintf(stderr, "Connect failed: %s\n", m.socket_path.c_str());
+				return 1;
+			}
+			if (r.op != MorseServer::WAV || status != 0)
+			{
+				cout << reply << "\n";
+				return status;
+			}
+			string filename = "morse" + to_string(time(NULL)) + ".wav";
+			FILE* file;
+#pragma warning(suppress : 4996)
+			if ((file = fopen(filename.c_str(), "wb")) == NULL || fwrite(reply.data(), reply.size(), 1, file) != 1)
+			{
+				fprintf(stderr, "Write failed: %s\n", filename.c_str());
+				return 1;
+			}
+			fclose(file);
+			printf("written to %s (%.1f kB)\n", filename.c_str(), reply.size() / 1024.0);
+			return 0;
+		}
 		if (action == "encode") cout << m.morse_encode(str) << "\n"; else
 			if (action == "binary") cout << m.morse_binary(str) << "\n"; else
 				if (action == "decode") cout << m.morse_decode(str) << "\n"; else
@@ -609,11 +1466,11 @@ int main(int argc, char* argv[])
 										cout << morse << "\n";
 										if (action == "wav")
 										{
-											MorseWav mw = MorseWav(morse.c_str(), m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, true, 2);
+											m.wav_file(morse, 2);
 										}
 										else if (action == "wav_mono")
 										{
-											MorseWav mw = MorseWav(morse.c_str(), m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, true, 1);
+											m.wav_file(morse, 1);
 										}
 										else
 										{
@@ -672,11 +1529,11 @@ int main(int argc, char* argv[])
 				cout << str << "\n";
 				if (action == "wav")
 				{
-					MorseWav mw = MorseWav(str.c_str(), m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, true, 2);
+					m.wav_file(str, 2);
 				}
 				else if (action == "wav_mono")
 				{
-					MorseWav mw = MorseWav(str.c_str(), m.frequency_in_hertz, m.words_per_minute, m.samples_per_second, true, 1);
+					m.wav_file(str, 1);
 				}
 				else
 				{